@@ -0,0 +1,232 @@
+//offline converter from wavefront .obj to the binary .mesh container
+//usage: MeshConverter input.obj output.mesh [--half] [--oct] [--no-optimise] [--lods n]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetIO.h"
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshLod.h"
+
+struct ObjMesh
+{
+	MeshData data;
+	std::vector<MeshFileSubmesh> submeshes;
+	std::vector<std::string> materials;
+};
+
+//obj indices are 1 based and negative ones count back from the end
+static int resolveIndex(long index, size_t count)
+{
+	if (index > 0) return (int)index - 1;
+	if (index < 0) return (int)count + (int)index;
+	return -1;
+}
+
+static void startSubmesh(ObjMesh& mesh, uint32_t material)
+{
+	MeshFileSubmesh submesh = {};
+	submesh.firstIndex = (uint32_t)mesh.data.indices.size();
+	submesh.material = material;
+
+	//reuse an empty trailing submesh rather than writing it out
+	if (!mesh.submeshes.empty() && mesh.submeshes.back().indexCount == 0)
+		mesh.submeshes.back() = submesh;
+	else
+		mesh.submeshes.push_back(submesh);
+}
+
+static bool parseObj(const char* path, ObjMesh& mesh)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "ERROR OPENING " << path << std::endl;
+		return false;
+	}
+
+	std::vector<float> positions, normals;
+	//(position, normal) pair -> output vertex
+	std::unordered_map<uint64_t, uint32_t> vertexLookup;
+	std::unordered_map<std::string, uint32_t> materialLookup;
+	std::vector<uint32_t> face;
+
+	startSubmesh(mesh, 0);
+
+	std::string line;
+	const char* cursor = file.data();
+	const char* end = cursor + file.size();
+	while (cursor < end)
+	{
+		const char* lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor);
+		if (!lineEnd) lineEnd = end;
+		line.assign(cursor, lineEnd);
+		cursor = lineEnd + 1;
+
+		const char* c = line.c_str();
+		if (c[0] == 'v' && c[1] == ' ')
+		{
+			float x = 0, y = 0, z = 0;
+			std::sscanf(c + 2, "%f %f %f", &x, &y, &z);
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (c[0] == 'v' && c[1] == 'n' && c[2] == ' ')
+		{
+			float x = 0, y = 0, z = 0;
+			std::sscanf(c + 3, "%f %f %f", &x, &y, &z);
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (std::strncmp(c, "usemtl ", 7) == 0)
+		{
+			std::string name(c + 7);
+			while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+				name.pop_back();
+
+			auto it = materialLookup.find(name);
+			uint32_t material = it != materialLookup.end() ? it->second : (uint32_t)mesh.materials.size();
+			if (it == materialLookup.end())
+			{
+				materialLookup.emplace(name, material);
+				mesh.materials.push_back(name);
+			}
+			startSubmesh(mesh, material);
+		}
+		else if (c[0] == 'f' && c[1] == ' ')
+		{
+			face.clear();
+			char* token = (char*)c + 2;
+			while (*token)
+			{
+				//v, v/t, v//n or v/t/n
+				char* next;
+				long v = std::strtol(token, &next, 10);
+				if (next == token) break;
+				long n = 0;
+				if (*next == '/')
+				{
+					next++;
+					if (*next != '/') std::strtol(next, &next, 10);
+					if (*next == '/') n = std::strtol(next + 1, &next, 10);
+				}
+				token = next;
+				while (*token == ' ' || *token == '\t' || *token == '\r') token++;
+
+				int position = resolveIndex(v, positions.size() / 3);
+				int normal = resolveIndex(n, normals.size() / 3);
+				if (position < 0 || (size_t)position >= positions.size() / 3)
+				{
+					std::cout << "ERROR BAD FACE INDEX IN " << path << std::endl;
+					return false;
+				}
+				if ((size_t)(normal + 1) > normals.size() / 3) normal = -1;
+
+				uint64_t key = ((uint64_t)(uint32_t)position << 32) | (uint32_t)(normal + 1);
+				auto it = vertexLookup.find(key);
+				if (it == vertexLookup.end())
+				{
+					uint32_t index = (uint32_t)mesh.data.vertexCount();
+					it = vertexLookup.emplace(key, index).first;
+					mesh.data.positions.insert(mesh.data.positions.end(), &positions[position * 3], &positions[position * 3] + 3);
+					if (normal >= 0)
+						mesh.data.normals.insert(mesh.data.normals.end(), &normals[normal * 3], &normals[normal * 3] + 3);
+					else
+						mesh.data.normals.insert(mesh.data.normals.end(), { 0.0f, 0.0f, 1.0f });
+				}
+				face.push_back(it->second);
+			}
+
+			//triangulate as a fan
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				mesh.data.indices.insert(mesh.data.indices.end(), { face[0], face[i - 1], face[i] });
+				mesh.submeshes.back().indexCount += 3;
+			}
+		}
+	}
+
+	if (mesh.submeshes.back().indexCount == 0)
+		mesh.submeshes.pop_back();
+	if (normals.empty())
+		mesh.data.normals.clear();
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "usage: MeshConverter input.obj output.mesh [--half] [--oct] [--no-optimise] [--lods n]" << std::endl;
+		return -1;
+	}
+
+	MeshOptions options;
+	bool optimise = true;
+	int lodCount = 1;
+	for (int i = 3; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--half") == 0) options.halfPositions = true;
+		else if (std::strcmp(argv[i], "--oct") == 0) options.octNormals = true;
+		else if (std::strcmp(argv[i], "--no-optimise") == 0) optimise = false;
+		else if (std::strcmp(argv[i], "--lods") == 0 && i + 1 < argc) lodCount = std::max(1, std::atoi(argv[++i]));
+	}
+
+	ObjMesh mesh;
+	if (!parseObj(argv[1], mesh))
+		return -1;
+
+	float acmrBefore = computeACMR(mesh.data.indices, mesh.data.vertexCount());
+	if (optimise)
+	{
+		//reorder inside each submesh so the ranges stay intact
+		for (const MeshFileSubmesh& submesh : mesh.submeshes)
+		{
+			std::vector<uint32_t> range(mesh.data.indices.begin() + submesh.firstIndex,
+				mesh.data.indices.begin() + submesh.firstIndex + submesh.indexCount);
+			optimiseVertexCache(range, mesh.data.vertexCount());
+			std::copy(range.begin(), range.end(), mesh.data.indices.begin() + submesh.firstIndex);
+		}
+		optimiseVertexFetch(mesh.data);
+	}
+	float acmrAfter = computeACMR(mesh.data.indices, mesh.data.vertexCount());
+
+	//each level halves the triangles of every submesh, level by level so a level's ranges stay together
+	size_t baseSubmeshes = mesh.submeshes.size();
+	for (int lod = 1; lod < lodCount; lod++)
+	{
+		for (size_t i = 0; i < baseSubmeshes; i++)
+		{
+			MeshFileSubmesh submesh = mesh.submeshes[i];
+			size_t target = (size_t)(submesh.indexCount >> lod) / 3 * 3;
+			std::vector<uint32_t> level;
+			float error = simplifyMesh(mesh.data, submesh.firstIndex, submesh.indexCount, target, level);
+			if (optimise)
+				optimiseVertexCache(level, mesh.data.vertexCount());
+
+			const MeshFileSubmesh& previous = mesh.submeshes[mesh.submeshes.size() - baseSubmeshes];
+			submesh.firstIndex = (uint32_t)mesh.data.indices.size();
+			submesh.indexCount = (uint32_t)level.size();
+			submesh.lod = (uint32_t)lod;
+			submesh.lodError = std::max(error, previous.lodError);
+			mesh.data.indices.insert(mesh.data.indices.end(), level.begin(), level.end());
+			mesh.submeshes.push_back(submesh);
+		}
+		std::printf("lod %d: %zu triangles, error %f\n", lod, (mesh.data.indices.size() - mesh.submeshes[mesh.submeshes.size() - baseSubmeshes].firstIndex) / 3,
+			mesh.submeshes.back().lodError);
+	}
+
+	if (!writeMeshFile(argv[2], mesh.data, options, mesh.submeshes))
+		return -1;
+
+	std::printf("%s: %zu vertices, %zu triangles, %zu submeshes, acmr %.3f -> %.3f\n", argv[2],
+		mesh.data.vertexCount(), mesh.data.indices.size() / 3, mesh.submeshes.size(), acmrBefore, acmrAfter);
+	for (size_t i = 0; i < mesh.materials.size(); i++)
+		std::printf("  material %zu: %s\n", i, mesh.materials[i].c_str());
+	return 0;
+}
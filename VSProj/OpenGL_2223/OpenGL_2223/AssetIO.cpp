@@ -0,0 +1,183 @@
+#include "AssetIO.h"
+
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		fileData = other.fileData;
+		fileSize = other.fileSize;
+		opened = other.opened;
+#ifdef _WIN32
+		fileHandle = other.fileHandle;
+		mappingHandle = other.mappingHandle;
+		other.fileHandle = nullptr;
+		other.mappingHandle = nullptr;
+#endif
+		other.fileData = nullptr;
+		other.fileSize = 0;
+		other.opened = false;
+	}
+	return *this;
+}
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	//empty files can't be mapped, they're just an empty view
+	if (length.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const char* view = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view == nullptr)
+		{
+			if (mapping) CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		mappingHandle = mapping;
+		fileData = view;
+	}
+	fileHandle = file;
+	fileSize = (size_t)length.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	if (info.st_size > 0)
+	{
+		void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			::close(fd);
+			return false;
+		}
+		//start paging it in now rather than on first touch
+		madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+		fileData = (const char*)view;
+	}
+	//the mapping stays valid after the descriptor is closed
+	::close(fd);
+	fileSize = (size_t)info.st_size;
+#endif
+
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (fileData) UnmapViewOfFile(fileData);
+	if (mappingHandle) CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle) CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (fileData) munmap((void*)fileData, fileSize);
+#endif
+	fileData = nullptr;
+	fileSize = 0;
+	opened = false;
+}
+
+bool AssetManifest::load(const char* manifestPath)
+{
+	MappedFile manifest;
+	if (!manifest.open(manifestPath))
+	{
+		std::cout << "ERROR OPENING ASSET MANIFEST " << manifestPath << std::endl;
+		return false;
+	}
+
+	std::string_view text = manifest.view();
+	size_t lineStart = 0;
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == std::string_view::npos) lineEnd = text.size();
+
+		std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		//trim whitespace and \r from windows line endings
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+			line.remove_suffix(1);
+		while (!line.empty() && (line.front() == ' ' || line.front() == '\t'))
+			line.remove_prefix(1);
+		if (line.empty() || line.front() == '#')
+			continue;
+
+		std::string path(line);
+		if (lookup.count(path))
+			continue;
+
+		MappedFile file;
+		if (!file.open(path.c_str()))
+		{
+			std::cout << "ERROR OPENING ASSET " << path << std::endl;
+			continue;
+		}
+		lookup.emplace(std::move(path), files.size());
+		files.push_back(std::move(file));
+	}
+	return true;
+}
+
+void AssetManifest::clear()
+{
+	files.clear();
+	lookup.clear();
+}
+
+const MappedFile* AssetManifest::find(std::string_view path) const
+{
+	auto it = lookup.find(std::string(path));
+	return it == lookup.end() ? nullptr : &files[it->second];
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//read-only memory mapping of a whole file, no copy and no null terminator
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const { return opened; }
+	const char* data() const { return fileData; }
+	size_t size() const { return fileSize; }
+	std::string_view view() const { return std::string_view(fileData, fileSize); }
+
+private:
+	const char* fileData = nullptr;
+	size_t fileSize = 0;
+	bool opened = false;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+//maps every file listed in a manifest (one path per line, # for comments) up front
+class AssetManifest
+{
+public:
+	bool load(const char* manifestPath);
+	void clear();
+
+	//null if the path wasn't in the manifest or failed to open
+	const MappedFile* find(std::string_view path) const;
+	size_t count() const { return files.size(); }
+
+private:
+	std::vector<MappedFile> files;
+	std::unordered_map<std::string, size_t> lookup;
+};
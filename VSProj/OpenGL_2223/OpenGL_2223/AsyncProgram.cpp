@@ -0,0 +1,207 @@
+#include "AsyncProgram.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "UniformBuffer.h"
+
+#include <iostream>
+
+void ProgramBuilder::init(ProgramCache* programCache)
+{
+	cache = programCache;
+
+	//let the driver pick how many compiler threads to use
+	if (glExt.parallelShaderCompile)
+		glExt.maxShaderCompilerThreads(0xFFFFFFFF);
+}
+
+ProgramHandle ProgramBuilder::submit(std::string_view vertexSrc, std::string_view fragmentSrc)
+{
+	ProgramHandle handle = (ProgramHandle)builds.size();
+	builds.emplace_back();
+	start(builds.back(), vertexSrc, fragmentSrc);
+	return handle;
+}
+
+void ProgramBuilder::reload(ProgramHandle handle, std::string_view vertexSrc, std::string_view fragmentSrc)
+{
+	//a newer edit replaces a reload that hasn't finished yet
+	for (size_t i = 0; i < reloads.size(); i++)
+	{
+		if (reloads[i].target == handle)
+		{
+			discard(reloads[i].build);
+			if (i + 1 < reloads.size())
+				reloads[i] = std::move(reloads.back());
+			reloads.pop_back();
+			break;
+		}
+	}
+
+	reloads.emplace_back();
+	Reload& reload = reloads.back();
+	reload.target = handle;
+	start(reload.build, vertexSrc, fragmentSrc);
+
+	//sources that were built before come straight out of the cache
+	if (reload.build.state == ProgramState::Ready)
+	{
+		swapIn(reload);
+		reloads.pop_back();
+	}
+}
+
+void ProgramBuilder::start(Build& build, std::string_view vertexSrc, std::string_view fragmentSrc)
+{
+	if (cache)
+	{
+		build.cacheKey = cache->makeKey(vertexSrc, fragmentSrc);
+		if (cache->load(build.program, build.cacheKey))
+		{
+			bindUniformBlocks(build.program);
+			build.reflection.reflect(build.program);
+			build.state = ProgramState::Ready;
+			return;
+		}
+	}
+
+	//glShaderSource copies the text, so the views only need to live until here
+	const char* src = vertexSrc.data();
+	GLint length = (GLint)vertexSrc.size();
+	build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertexShader, 1, &src, &length);
+	glCompileShader(build.vertexShader);
+
+	src = fragmentSrc.data();
+	length = (GLint)fragmentSrc.size();
+	build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragmentShader, 1, &src, &length);
+	glCompileShader(build.fragmentShader);
+
+	//link straight away, a failed compile just shows up as a failed link
+	build.program = glCreateProgram();
+	glAttachShader(build.program, build.vertexShader);
+	glAttachShader(build.program, build.fragmentShader);
+	if (cache) cache->prepareLink(build.program);
+	glLinkProgram(build.program);
+
+	pending++;
+}
+
+bool ProgramBuilder::isComplete(const Build& build) const
+{
+	if (!glExt.parallelShaderCompile)
+		return true;
+
+	int done;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done != 0;
+}
+
+void ProgramBuilder::finish(Build& build)
+{
+	int success;
+	char infoLog[512];
+	glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+	if (success)
+	{
+		bindUniformBlocks(build.program);
+		build.reflection.reflect(build.program);
+		build.state = ProgramState::Ready;
+		if (cache) cache->store(build.program, build.cacheKey);
+	}
+	else
+	{
+		build.state = ProgramState::Failed;
+
+		glGetShaderiv(build.vertexShader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(build.vertexShader, 512, nullptr, infoLog);
+			std::cout << "ERROR COMPILING VERTEX SHADER\n" << infoLog << std::endl;
+		}
+		glGetShaderiv(build.fragmentShader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(build.fragmentShader, 512, nullptr, infoLog);
+			std::cout << "ERROR COMPILING FRAGMENT SHADER\n" << infoLog << std::endl;
+		}
+		glGetProgramInfoLog(build.program, 512, nullptr, infoLog);
+		std::cout << "ERROR LINKING PROGRAM\n" << infoLog << std::endl;
+
+		glDeleteProgram(build.program);
+		build.program = 0;
+	}
+
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+	build.vertexShader = build.fragmentShader = 0;
+
+	pending--;
+}
+
+void ProgramBuilder::discard(Build& build)
+{
+	if (build.state == ProgramState::Pending)
+	{
+		glDeleteShader(build.vertexShader);
+		glDeleteShader(build.fragmentShader);
+		pending--;
+	}
+	//gl holds on to a program that queued draws still use until they're done
+	if (build.program)
+		glDeleteProgram(build.program);
+	build.vertexShader = build.fragmentShader = build.program = 0;
+}
+
+void ProgramBuilder::swapIn(Reload& reload)
+{
+	Build& target = builds[reload.target];
+	discard(target);
+	target = std::move(reload.build);
+	reload.build = Build();
+}
+
+void ProgramBuilder::poll()
+{
+	if (pending == 0)
+		return;
+
+	//without the extension checking the status blocks, so spread it over frames
+	unsigned budget = glExt.parallelShaderCompile ? 0xFFFFFFFF : 1;
+	for (Build& build : builds)
+	{
+		if (budget == 0)
+			return;
+		if (build.state != ProgramState::Pending || !isComplete(build))
+			continue;
+
+		finish(build);
+		budget--;
+	}
+
+	for (size_t i = 0; i < reloads.size() && budget > 0;)
+	{
+		Reload& reload = reloads[i];
+		if (!isComplete(reload.build))
+		{
+			i++;
+			continue;
+		}
+
+		finish(reload.build);
+		budget--;
+		if (reload.build.state == ProgramState::Ready)
+			swapIn(reload);
+		else
+			std::cout << "ERROR RELOADING PROGRAM " << reload.target << ", KEEPING THE PREVIOUS ONE" << std::endl;
+		if (i + 1 < reloads.size())
+			reloads[i] = std::move(reloads.back());
+		reloads.pop_back();
+	}
+}
+
+GLuint ProgramBuilder::get(ProgramHandle handle, GLuint fallback) const
+{
+	const Build& build = builds[handle];
+	return build.state == ProgramState::Ready ? build.program : fallback;
+}
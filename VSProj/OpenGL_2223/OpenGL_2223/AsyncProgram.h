@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ProgramReflection.h"
+
+class ProgramCache;
+
+enum class ProgramState
+{
+	Pending,
+	Ready,
+	Failed
+};
+
+//index into the builder, stays valid for the builder's lifetime
+typedef unsigned ProgramHandle;
+
+//submits every compile & link up front and polls for completion instead of blocking
+//on GL_COMPILE_STATUS / GL_LINK_STATUS. with KHR_parallel_shader_compile the driver
+//compiles on its own threads, without it at most one build is finalised per poll()
+class ProgramBuilder
+{
+public:
+	//needs a current context, cache may be null
+	void init(ProgramCache* cache);
+
+	ProgramHandle submit(std::string_view vertexSrc, std::string_view fragmentSrc);
+	//builds new sources for an existing handle. get() keeps returning the current program
+	//until the new one has linked, then poll() swaps it in. if it fails the current one stays
+	void reload(ProgramHandle handle, std::string_view vertexSrc, std::string_view fragmentSrc);
+
+	//call once per frame, finished builds and reloads take effect here
+	void poll();
+
+	ProgramState getState(ProgramHandle handle) const { return builds[handle].state; }
+	//the linked program, or fallback until it's ready (or if it failed)
+	GLuint get(ProgramHandle handle, GLuint fallback) const;
+	//uniforms/attributes/blocks of the linked program, empty until it's ready
+	const ProgramReflection& getReflection(ProgramHandle handle) const { return builds[handle].reflection; }
+
+	unsigned pendingCount() const { return pending; }
+	unsigned reloadingCount() const { return (unsigned)reloads.size(); }
+
+private:
+	struct Build
+	{
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		GLuint program = 0;
+		ProgramState state = ProgramState::Pending;
+		uint64_t cacheKey = 0;
+		ProgramReflection reflection;
+	};
+
+	struct Reload
+	{
+		ProgramHandle target;
+		Build build;
+	};
+
+	//compiles and links, or loads from the cache straight to Ready
+	void start(Build& build, std::string_view vertexSrc, std::string_view fragmentSrc);
+	bool isComplete(const Build& build) const;
+	void finish(Build& build);
+	//deletes whatever gl objects the build still owns
+	void discard(Build& build);
+	void swapIn(Reload& reload);
+
+	std::vector<Build> builds;
+	std::vector<Reload> reloads;
+	ProgramCache* cache = nullptr;
+	unsigned pending = 0;
+};
@@ -0,0 +1,1261 @@
+#include "Benchmark.h"
+
+#include "Bvh.h"
+#include "CommandBuffer.h"
+#include "Culling.h"
+#include "Entities.h"
+#include "JobSystem.h"
+#include "Memory.h"
+#include "Mesh.h"
+#include "MeshLod.h"
+#include "Occlusion.h"
+#include "ProgramReflection.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+FrameSampler::FrameSampler(const char* name) : name(name)
+{
+}
+
+void FrameSampler::reserve(size_t frames)
+{
+	samples.reserve(frames);
+}
+
+void FrameSampler::add(double ms)
+{
+	samples.push_back(ms);
+}
+
+void FrameSampler::report() const
+{
+	if (samples.empty())
+	{
+		std::printf("%-10s no samples\n", name);
+		return;
+	}
+
+	//sort a copy so the samples stay in frame order
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	size_t last = sorted.size() - 1;
+	double median = sorted[last / 2];
+	double p99 = sorted[(last * 99) / 100];
+
+	std::printf("%-10s min %8.3f ms  median %8.3f ms  p99 %8.3f ms  (%zu frames)\n",
+		name, sorted[0], median, p99, sorted.size());
+}
+
+uint64_t timerNow()
+{
+	return glfwGetTimerValue();
+}
+
+double timerMs(uint64_t start, uint64_t end)
+{
+	return (double)(end - start) * 1000.0 / (double)glfwGetTimerFrequency();
+}
+
+//wall clock for the cpu benchmarks, glfw isn't initialised for those
+static double nowMs()
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int benchMesh(int size)
+{
+	if (size <= 0) size = 256;
+	MeshData grid = createGridMesh(size);
+	size_t vertices = grid.vertexCount();
+	std::printf("grid %dx%d: %zu vertices, %zu triangles\n", size, size, vertices, grid.indices.size() / 3);
+	std::printf("row order  acmr %.3f\n", computeACMR(grid.indices, vertices));
+
+	//shuffle triangles to stand in for badly ordered exporter output
+	std::mt19937 rng(1234);
+	size_t triangles = grid.indices.size() / 3;
+	for (size_t t = triangles - 1; t > 0; t--)
+	{
+		size_t other = rng() % (t + 1);
+		for (int corner = 0; corner < 3; corner++)
+			std::swap(grid.indices[t * 3 + corner], grid.indices[other * 3 + corner]);
+	}
+	std::printf("shuffled   acmr %.3f\n", computeACMR(grid.indices, vertices));
+
+	double start = nowMs();
+	optimiseMesh(grid);
+	double end = nowMs();
+	std::printf("tipsify    acmr %.3f  (%.2f ms)\n", computeACMR(grid.indices, grid.vertexCount()), end - start);
+	return 0;
+}
+
+//stands in for scene traversal: build a transform per object and record its draw
+static void recordRange(CommandBuffer& buffer, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		float angle = i * 0.001f;
+		float c = std::cos(angle), s = std::sin(angle);
+		float m[16] =
+		{
+			c, s, 0.0f, 0.0f,
+			-s, c, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			(float)(i % 100), (float)(i / 100), 0.0f, 1.0f
+		};
+		buffer.uniformMatrix4(0, m);
+
+		DrawPacket packet = { 1, (GLuint)(1 + i % 8), 0, 0.0f, GL_TRIANGLES, 0, 36, GL_UNSIGNED_SHORT };
+		buffer.draw(packet);
+	}
+}
+
+static double recordFrame(CommandQueue& queue, int draws, int threads)
+{
+	double start = nowMs();
+	queue.begin(threads);
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+		workers.emplace_back(recordRange, std::ref(queue.get(t)), draws * t / threads, draws * (t + 1) / threads);
+	recordRange(queue.get(0), 0, draws / threads);
+	for (std::thread& worker : workers)
+		worker.join();
+
+	return nowMs() - start;
+}
+
+static int benchCommands(int size)
+{
+	int draws = size > 0 ? size : 100000;
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		CommandQueue queue;
+		double best = 1e30;
+		//first run grows the arenas, the rest show the steady state
+		for (int run = 0; run < 10; run++)
+			best = std::min(best, recordFrame(queue, draws, threads));
+
+		std::printf("%2d threads  %8.3f ms  %zu commands\n", threads, best, queue.getCommandCount());
+	}
+	return 0;
+}
+
+//name lookups the way a material system would do them every draw
+static int benchReflection(int size)
+{
+	int names = size > 0 ? size : 64;
+	const int lookups = 10000000;
+
+	std::vector<std::string> strings;
+	std::vector<uint32_t> hashes;
+	std::unordered_map<std::string, int> map;
+	for (int i = 0; i < names; i++)
+	{
+		strings.push_back("uniform" + std::to_string(i));
+		hashes.push_back(nameHash(strings.back()));
+		map[strings.back()] = i;
+	}
+
+	double start = nowMs();
+	PerfectHashTable table;
+	table.build(hashes);
+	std::printf("%d names, table built in %.3f ms\n", names, nowMs() - start);
+
+	//the hash is a compile time constant at real call sites, so only the lookup is timed
+	long long sum = 0;
+	start = nowMs();
+	for (int i = 0; i < lookups; i++)
+		sum += table.find(hashes[i % names]);
+	double perfectMs = nowMs() - start;
+
+	start = nowMs();
+	for (int i = 0; i < lookups; i++)
+		sum += map.find(strings[i % names])->second;
+	double mapMs = nowMs() - start;
+
+	std::printf("perfect hash   %8.3f ms  (%.2f ns per lookup)\n", perfectMs, perfectMs * 1e6 / lookups);
+	std::printf("unordered_map  %8.3f ms  (%.2f ns per lookup)\n", mapMs, mapMs * 1e6 / lookups);
+
+	//every name has to come back as itself
+	for (int i = 0; i < names; i++)
+	{
+		if (table.find(hashes[i]) != i)
+		{
+			std::printf("ERROR lookup of %s returned %d\n", strings[i].c_str(), table.find(hashes[i]));
+			return -1;
+		}
+	}
+	std::printf("checksum %lld\n", sum);
+	return 0;
+}
+
+//column-major gl perspective, camera at the origin looking down -z
+static void makePerspective(float* m, float fovY, float aspect, float zNear, float zFar)
+{
+	float f = 1.0f / std::tan(fovY * 0.5f);
+	for (int i = 0; i < 16; i++) m[i] = 0.0f;
+	m[0] = f / aspect;
+	m[5] = f;
+	m[10] = (zFar + zNear) / (zNear - zFar);
+	m[11] = -1.0f;
+	m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+static int benchCulling(int size)
+{
+	int objects = size > 0 ? size : 1000000;
+
+	//random objects all around the camera, most of them end up behind or beside it
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 5.0f);
+	CullingSet set;
+	set.reserve(objects);
+	for (int i = 0; i < objects; i++)
+	{
+		float center[3] = { position(rng), position(rng), position(rng) };
+		float half[3] = { extent(rng), extent(rng), extent(rng) };
+		float boundsMin[3] = { center[0] - half[0], center[1] - half[1], center[2] - half[2] };
+		float boundsMax[3] = { center[0] + half[0], center[1] + half[1], center[2] + half[2] };
+		set.add(center, std::sqrt(half[0] * half[0] + half[1] * half[1] + half[2] * half[2]), boundsMin, boundsMax);
+	}
+
+	float viewProjection[16];
+	makePerspective(viewProjection, 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	Frustum frustum = makeFrustum(viewProjection);
+
+	std::printf("%d objects, best kernel %s\n", objects, cullKernelName(bestCullKernel()));
+
+	std::vector<uint32_t> visible, reference;
+	set.cullSpheres(frustum, reference, CullKernel::Scalar);
+	size_t sphereVisible = reference.size();
+	set.cullBoxes(frustum, reference, CullKernel::Scalar);
+	size_t boxVisible = reference.size();
+
+	CullKernel kernels[] = { CullKernel::Scalar, CullKernel::SSE, CullKernel::AVX2 };
+	for (CullKernel kernel : kernels)
+	{
+		if ((int)kernel > (int)bestCullKernel())
+			continue;
+
+		double sphereMs = 1e30, boxMs = 1e30;
+		for (int run = 0; run < 10; run++)
+		{
+			double start = nowMs();
+			set.cullSpheres(frustum, visible, kernel);
+			sphereMs = std::min(sphereMs, nowMs() - start);
+			if (visible.size() != sphereVisible)
+			{
+				std::printf("ERROR %s spheres found %zu visible, scalar %zu\n", cullKernelName(kernel), visible.size(), sphereVisible);
+				return -1;
+			}
+
+			start = nowMs();
+			set.cullBoxes(frustum, visible, kernel);
+			boxMs = std::min(boxMs, nowMs() - start);
+			if (visible != reference)
+			{
+				std::printf("ERROR %s boxes don't match scalar\n", cullKernelName(kernel));
+				return -1;
+			}
+		}
+		std::printf("%-6s spheres %8.3f ms (%zu visible)  boxes %8.3f ms (%zu visible)\n",
+			cullKernelName(kernel), sphereMs, sphereVisible, boxMs, boxVisible);
+	}
+	return 0;
+}
+
+static void randomBoxes(std::vector<Aabb>& boxes, int count, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 5.0f);
+	boxes.resize(count);
+	for (Aabb& box : boxes)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float center = position(rng), half = extent(rng);
+			box.min[axis] = center - half;
+			box.max[axis] = center + half;
+		}
+	}
+}
+
+static int benchBvh(int size)
+{
+	int largest = size > 0 ? size : 1000000;
+
+	//short far plane so only a small part of the scene is visible, the case a hierarchy is for
+	float viewProjection[16];
+	makePerspective(viewProjection, 1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	Frustum frustum = makeFrustum(viewProjection);
+	const float center[3] = { 0.0f, 0.0f, -50.0f };
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	const float direction[3] = { 0.3f, -0.2f, -1.0f };
+
+	std::printf("%10s %10s %10s %12s %12s %12s %12s\n", "objects", "nodes", "build ms", "frustum us", "flat us", "sphere us", "ray us");
+
+	std::vector<Aabb> boxes;
+	std::vector<uint32_t> found, reference;
+	int sizes[] = { std::max(largest / 100, 1), std::max(largest / 10, 1), largest };
+	for (int objects : sizes)
+	{
+		std::mt19937 rng(1234);
+		randomBoxes(boxes, objects, rng);
+
+		double start = nowMs();
+		Bvh bvh;
+		bvh.build(boxes);
+		double buildMs = nowMs() - start;
+
+		CullingSet set;
+		set.reserve(objects);
+		for (const Aabb& box : boxes)
+		{
+			float sphereCenter[3] = { (box.min[0] + box.max[0]) * 0.5f, (box.min[1] + box.max[1]) * 0.5f, (box.min[2] + box.max[2]) * 0.5f };
+			set.add(sphereCenter, 0.0f, box.min, box.max);
+		}
+
+		double frustumMs = 1e30, flatMs = 1e30, sphereMs = 1e30, rayMs = 1e30;
+		BvhHit hit;
+		for (int run = 0; run < 10; run++)
+		{
+			start = nowMs();
+			bvh.queryFrustum(frustum, found);
+			frustumMs = std::min(frustumMs, nowMs() - start);
+
+			start = nowMs();
+			set.cullBoxes(frustum, reference);
+			flatMs = std::min(flatMs, nowMs() - start);
+
+			start = nowMs();
+			bvh.querySphere(center, 50.0f, found);
+			sphereMs = std::min(sphereMs, nowMs() - start);
+
+			start = nowMs();
+			hit = bvh.raycast(origin, direction);
+			rayMs = std::min(rayMs, nowMs() - start);
+		}
+
+		//the hierarchy has to find exactly what the flat pass finds
+		bvh.queryFrustum(frustum, found);
+		std::sort(found.begin(), found.end());
+		if (found != reference)
+		{
+			std::printf("ERROR bvh found %zu visible, flat culling %zu\n", found.size(), reference.size());
+			return -1;
+		}
+
+		std::printf("%10d %10zu %10.2f %12.2f %12.2f %12.2f %12.2f  (%zu visible, ray hit %d)\n", objects, bvh.getNodeCount(), buildMs,
+			frustumMs * 1000.0, flatMs * 1000.0, sphereMs * 1000.0, rayMs * 1000.0, reference.size(), hit.object);
+	}
+
+	//everything drifts a little each frame, refit until the tree has degraded, then rebuild
+	Bvh bvh;
+	bvh.build(boxes);
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> drift(-10.0f, 10.0f);
+	double refitMs = 1e30;
+	int frame = 0;
+	for (; frame < 100 && bvh.getQualityRatio() < 1.5f; frame++)
+	{
+		for (uint32_t i = 0; i < boxes.size(); i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float d = drift(rng);
+				boxes[i].min[axis] += d;
+				boxes[i].max[axis] += d;
+			}
+			bvh.setBounds(i, boxes[i]);
+		}
+		double start = nowMs();
+		bvh.refit();
+		refitMs = std::min(refitMs, nowMs() - start);
+	}
+	std::printf("refit %.2f ms, quality %.2fx after %d frames of drift\n", refitMs, bvh.getQualityRatio(), frame);
+
+	double start = nowMs();
+	bvh.rebuildAsync();
+	while (!bvh.pollRebuild())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::printf("background rebuild %.2f ms, quality %.2fx\n", nowMs() - start, bvh.getQualityRatio());
+	return 0;
+}
+
+//vertical quad facing the camera
+static void addWall(std::vector<float>& positions, std::vector<uint32_t>& indices, float x0, float x1, float y0, float y1, float z)
+{
+	uint32_t first = (uint32_t)positions.size() / 3;
+	float corners[] = { x0, y0, z, x1, y0, z, x1, y1, z, x0, y1, z };
+	positions.insert(positions.end(), corners, corners + 12);
+	uint32_t quad[] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+	indices.insert(indices.end(), quad, quad + 6);
+}
+
+static int benchOcclusion(int size)
+{
+	int objects = size > 0 ? size : 100000;
+
+	//an interior: two rows of wall panels with doorways, small objects scattered behind
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	for (int panel = 0; panel < 8; panel++)
+	{
+		float x = -40.0f + panel * 10.0f;
+		addWall(positions, indices, x, x + 8.0f, -20.0f, 20.0f, -20.0f);
+		addWall(positions, indices, x + 5.0f, x + 13.0f, -40.0f, 40.0f, -60.0f);
+	}
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> across(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> depth(25.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.2f, 2.0f);
+	std::vector<Aabb> bounds(objects);
+	std::vector<uint32_t> candidates(objects);
+	for (int i = 0; i < objects; i++)
+	{
+		//inside the view cone so frustum culling wouldn't remove any of them
+		float z = depth(rng), x = across(rng) * z * 0.8f, y = across(rng) * z * 0.45f, half = extent(rng);
+		bounds[i] = { { x - half, y - half, -z - half }, { x + half, y + half, -z + half } };
+		candidates[i] = i;
+	}
+
+	float viewProjection[16];
+	makePerspective(viewProjection, 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	OcclusionBuffer occlusion;
+	occlusion.init(320, 180);
+	std::printf("%d objects, %dx%d depth buffer\n", objects, occlusion.getWidth(), occlusion.getHeight());
+
+	//threads split the tiles, every thread count must give the same depth
+	std::vector<float> reference;
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem jobs;
+		jobs.init(threads);
+		double rasterMs = 1e30;
+		for (int run = 0; run < 20; run++)
+		{
+			double start = nowMs();
+			occlusion.beginFrame(viewProjection);
+			occlusion.addOccluder(positions.data(), positions.size() / 3, indices.data(), indices.size());
+			occlusion.rasterize(&jobs);
+			rasterMs = std::min(rasterMs, nowMs() - start);
+		}
+		if (reference.empty())
+			reference = occlusion.getDepth();
+		else if (occlusion.getDepth() != reference)
+		{
+			std::printf("ERROR %d threads rasterised a different depth buffer\n", threads);
+			return -1;
+		}
+		std::printf("%2d threads  rasterise + pyramid %8.3f ms  (%zu triangles)\n", threads, rasterMs, occlusion.getTriangleCount());
+	}
+
+	double testMs = 1e30;
+	std::vector<uint32_t> visible;
+	for (int run = 0; run < 10; run++)
+	{
+		visible = candidates;
+		double start = nowMs();
+		occlusion.filterVisible(bounds, visible);
+		testMs = std::min(testMs, nowMs() - start);
+	}
+
+	//the pyramid is coarser than the depth buffer, it may keep more but never hide more
+	size_t exactHidden = 0;
+	for (int i = 0; i < objects; i++)
+	{
+		bool exact = occlusion.testBox(bounds[i], false);
+		exactHidden += !exact;
+		if (!exact || occlusion.testBox(bounds[i]))
+			continue;
+		std::printf("ERROR hi-z hid object %d that the full resolution test keeps\n", i);
+		return -1;
+	}
+
+	std::printf("test %8.3f ms, %zu of %d hidden (%zu by the full resolution test)\n",
+		testMs, objects - visible.size(), objects, exactHidden);
+	return 0;
+}
+
+static int benchLod(int size)
+{
+	//vertices per side, 80 is glfw's heightmap example
+	int side = size > 1 ? size : 80;
+	MeshData data = createHeightmapMesh(side - 1);
+	optimiseMesh(data);
+
+	double start = nowMs();
+	buildLods(data, 6);
+	double buildMs = nowMs() - start;
+	std::printf("%dx%d heightmap, %zu levels built in %.2f ms\n", side, side, data.lods.size(), buildMs);
+
+	for (size_t l = 0; l < data.lods.size(); l++)
+	{
+		const MeshLod& lod = data.lods[l];
+		for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i += 3)
+		{
+			const uint32_t* tri = &data.indices[i];
+			if (tri[0] >= data.vertexCount() || tri[1] >= data.vertexCount() || tri[2] >= data.vertexCount()
+				|| tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+			{
+				std::printf("ERROR level %zu has a bad triangle at %u\n", l, i);
+				return -1;
+			}
+		}
+		if (l > 0 && lod.error < data.lods[l - 1].error)
+		{
+			std::printf("ERROR level %zu has less error than the level before\n", l);
+			return -1;
+		}
+		std::printf("  level %zu  %6u triangles  error %.5f\n", l, lod.indexCount / 3, lod.error);
+	}
+
+	//a field of copies from 1 to 200 units away under a 60 degree perspective
+	float viewProjection[16];
+	makePerspective(viewProjection, 1.0472f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	const int copies = 10000;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> distance(1.0f, 200.0f);
+	std::vector<float> distances(copies);
+	for (float& d : distances)
+		d = distance(rng);
+
+	size_t fullTriangles = (size_t)copies * data.lods[0].indexCount / 3, lodTriangles = 0;
+	std::vector<int> lods(copies, 0);
+	start = nowMs();
+	for (int i = 0; i < copies; i++)
+	{
+		float center[3] = { 0.0f, 0.0f, -distances[i] };
+		lods[i] = selectLod(data.lods, lodPixelsPerUnit(viewProjection, center, 1.0f, 720), lods[i]);
+		lodTriangles += data.lods[lods[i]].indexCount / 3;
+	}
+	double selectMs = nowMs() - start;
+	std::printf("%d copies at 720p: %zu triangles instead of %zu (%.1f%%), selection %.3f ms\n",
+		copies, lodTriangles, fullTriangles, 100.0 * lodTriangles / fullTriangles, selectMs);
+
+	//an object drifting back and forth across every switch distance, 2% jitter per frame
+	int switches[2] = {};
+	for (int pass = 0; pass < 2; pass++)
+	{
+		float hysteresis = pass == 0 ? 0.0f : 0.25f;
+		int lod = 0;
+		for (int frame = 0; frame < 10000; frame++)
+		{
+			float d = 1.0f + 100.0f * (frame / 10000.0f) + ((frame & 1) ? 0.02f : -0.02f) * (1.0f + frame / 100.0f);
+			float center[3] = { 0.0f, 0.0f, -d };
+			int next = selectLod(data.lods, lodPixelsPerUnit(viewProjection, center, 1.0f, 720), lod, 1.0f, hysteresis);
+			switches[pass] += next != lod;
+			lod = next;
+		}
+	}
+	std::printf("jittering camera: %d lod switches without hysteresis, %d with\n", switches[0], switches[1]);
+	return 0;
+}
+
+//enough arithmetic per element that memory bandwidth doesn't cap the scaling
+static float jobWork(uint32_t i)
+{
+	float x = (float)i * 0.001f;
+	for (int k = 0; k < 64; k++)
+		x = x * 0.999f + std::sqrt(x + (float)k);
+	return x;
+}
+
+static int benchJobs(int size)
+{
+	uint32_t count = size > 0 ? (uint32_t)size : 1u << 20;
+	std::vector<float> out(count);
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	float expected = 0.0f;
+	for (uint32_t i = 0; i < count; i += 4097)
+		expected += jobWork(i);
+
+	std::printf("parallel_for over %u elements\n", count);
+	double single = 0.0;
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	for (int threads : threadCounts)
+	{
+		JobSystem jobs;
+		jobs.init(threads);
+
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			std::fill(out.begin(), out.end(), 0.0f);
+			double start = nowMs();
+			jobs.parallelFor(count, 256, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+					out[i] = jobWork(i);
+			});
+			best = std::min(best, nowMs() - start);
+
+			float check = 0.0f;
+			for (uint32_t i = 0; i < count; i += 4097)
+				check += out[i];
+			if (check != expected)
+			{
+				std::printf("ERROR %d threads computed a different result\n", threads);
+				return -1;
+			}
+		}
+		if (threads == 1)
+			single = best;
+
+		//a chain of dependent stages, each fanning out into many small jobs
+		const int STAGES = 8, JOBS_PER_STAGE = 256;
+		std::atomic<int> stageDone[STAGES];
+		for (std::atomic<int>& done : stageDone)
+			done = 0;
+		struct Stage { std::atomic<int>* done; std::atomic<int>* previous; bool ordered; };
+		std::vector<Stage> stages(STAGES);
+		std::vector<JobCounter> counters(STAGES);
+		for (int stage = 0; stage < STAGES; stage++)
+			stages[stage] = { &stageDone[stage], stage > 0 ? &stageDone[stage - 1] : nullptr, true };
+
+		double chainStart = nowMs();
+		for (int stage = 0; stage < STAGES; stage++)
+		{
+			for (int job = 0; job < JOBS_PER_STAGE; job++)
+			{
+				jobs.run([](void* data, uint32_t, uint32_t)
+				{
+					Stage& stage = *(Stage*)data;
+					//every job of the stage before has to be finished already
+					if (stage.previous && stage.previous->load() != JOBS_PER_STAGE)
+						stage.ordered = false;
+					stage.done->fetch_add(1);
+				}, &stages[stage], 0, 0, &counters[stage], stage > 0 ? &counters[stage - 1] : nullptr);
+			}
+		}
+		jobs.wait(counters[STAGES - 1]);
+		double chainMs = nowMs() - chainStart;
+		for (const Stage& stage : stages)
+		{
+			if (!stage.ordered)
+			{
+				std::printf("ERROR a job ran before the stage it depends on finished\n");
+				return -1;
+			}
+		}
+
+		const JobSystemStats& stats = jobs.getStats();
+		std::printf("%2d threads  %8.3f ms  speedup %5.2fx  (%llu jobs, %llu stolen)  %d dependent jobs %6.3f ms\n", threads, best, single / best,
+			(unsigned long long)stats.executed.load(), (unsigned long long)stats.stolen.load(), STAGES * JOBS_PER_STAGE, chainMs);
+	}
+	return 0;
+}
+
+//a render packet sized object for the pool comparison
+struct PooledNode
+{
+	float transform[16];
+	uint32_t parent;
+	uint32_t firstChild;
+};
+
+static int benchMemory(int size)
+{
+	int count = size > 0 ? size : 1000000;
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> sizes(16, 256);
+	std::vector<size_t> requests(count);
+	for (size_t& request : requests)
+		request = sizes(rng);
+	std::vector<void*> pointers(count);
+
+	//a frame's worth of small transient allocations, freed at the end of the frame
+	double mallocMs = 1e30, arenaMs = 1e30;
+	LinearArena arena(1024 * 1024);
+	for (int run = 0; run < 5; run++)
+	{
+		double start = nowMs();
+		for (int i = 0; i < count; i++)
+			pointers[i] = std::malloc(requests[i]);
+		for (int i = 0; i < count; i++)
+			std::free(pointers[i]);
+		mallocMs = std::min(mallocMs, nowMs() - start);
+
+		start = nowMs();
+		for (int i = 0; i < count; i++)
+			pointers[i] = arena.allocate(requests[i], 16);
+		arena.reset();
+		arenaMs = std::min(arenaMs, nowMs() - start);
+	}
+	std::printf("%d transient allocations  malloc/free %8.3f ms  arena %8.3f ms\n", count, mallocMs, arenaMs);
+
+	//objects created and destroyed in random order, the pool reuses slots through its free list
+	std::vector<PooledNode*> nodes(count / 10);
+	std::uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+	std::vector<size_t> churn(count);
+	for (size_t& index : churn)
+		index = pick(rng);
+
+	double newMs = 1e30, poolMs = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		double start = nowMs();
+		for (PooledNode*& node : nodes)
+			node = new PooledNode();
+		for (size_t index : churn)
+		{
+			delete nodes[index];
+			nodes[index] = new PooledNode();
+		}
+		for (PooledNode* node : nodes)
+			delete node;
+		newMs = std::min(newMs, nowMs() - start);
+
+		ObjectPool<PooledNode> pool;
+		pool.reserve(nodes.size());
+		start = nowMs();
+		for (PooledNode*& node : nodes)
+			node = pool.create();
+		for (size_t index : churn)
+		{
+			pool.destroy(nodes[index]);
+			nodes[index] = pool.create();
+		}
+		for (PooledNode* node : nodes)
+			pool.destroy(node);
+		poolMs = std::min(poolMs, nowMs() - start);
+	}
+	std::printf("%d node create/destroy    new/delete %8.3f ms  pool  %8.3f ms\n", count, newMs, poolMs);
+
+	//every worker allocating at once, the heap has to lock where the arenas don't
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem jobs;
+		jobs.init(threads);
+		FrameAllocator frameMemory;
+		frameMemory.init(threads, 1024 * 1024);
+
+		double heapMs = 1e30, localMs = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			double start = nowMs();
+			jobs.parallelFor((uint32_t)count, 1024, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+					pointers[i] = std::malloc(requests[i]);
+				for (uint32_t i = begin; i < end; i++)
+					std::free(pointers[i]);
+			});
+			heapMs = std::min(heapMs, nowMs() - start);
+
+			start = nowMs();
+			jobs.parallelFor((uint32_t)count, 1024, [&](uint32_t begin, uint32_t end)
+			{
+				LinearArena& local = frameMemory.local();
+				for (uint32_t i = begin; i < end; i++)
+					pointers[i] = local.allocate(requests[i], 16);
+			});
+			frameMemory.reset();
+			localMs = std::min(localMs, nowMs() - start);
+		}
+		std::printf("%2d threads               malloc/free %8.3f ms  arenas %7.3f ms\n", threads, heapMs, localMs);
+	}
+
+	//the per-frame cpu work of the main loop, none of it should reach the heap once warm
+	CullingSet set;
+	std::vector<Aabb> bounds;
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	for (int i = 0; i < 10000; i++)
+	{
+		float center[3] = { position(rng), position(rng), position(rng) - 60.0f };
+		float boundsMin[3] = { center[0] - 0.5f, center[1] - 0.5f, center[2] - 0.5f };
+		float boundsMax[3] = { center[0] + 0.5f, center[1] + 0.5f, center[2] + 0.5f };
+		set.add(center, 0.87f, boundsMin, boundsMax);
+		bounds.push_back({ { boundsMin[0], boundsMin[1], boundsMin[2] }, { boundsMax[0], boundsMax[1], boundsMax[2] } });
+	}
+	std::vector<float> wall;
+	std::vector<uint32_t> wallIndices;
+	addWall(wall, wallIndices, -20.0f, 0.0f, -20.0f, 20.0f, -30.0f);
+
+	float viewProjection[16];
+	makePerspective(viewProjection, 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	Frustum frustum = makeFrustum(viewProjection);
+
+	JobSystem jobs;
+	jobs.init(maxThreads);
+	FrameAllocator frameMemory;
+	frameMemory.init(maxThreads);
+	OcclusionBuffer occlusion;
+	occlusion.init(320, 180);
+	CommandQueue queue;
+	std::vector<uint32_t> visible;
+	HeapFrameCounter heapCounter(10);
+	for (int frame = 0; frame < 200; frame++)
+	{
+		heapCounter.beginFrame();
+		set.cullBoxes(frustum, visible);
+		occlusion.beginFrame(viewProjection);
+		occlusion.addOccluder(wall.data(), wall.size() / 3, wallIndices.data(), wallIndices.size());
+		occlusion.rasterize(&jobs);
+		occlusion.filterVisible(bounds, visible);
+
+		queue.begin(1);
+		CommandBuffer& commands = queue.get(0);
+		uint32_t* order = frameMemory.local().allocate<uint32_t>(visible.size());
+		std::copy(visible.begin(), visible.end(), order);
+		for (size_t i = 0; i < visible.size(); i++)
+		{
+			DrawPacket packet = { 1, 1, 0, 0.0f, GL_TRIANGLES, 0, 36, GL_UNSIGNED_SHORT };
+			packet.first = (GLint)order[i];
+			commands.draw(packet);
+		}
+		frameMemory.reset();
+		heapCounter.endFrame();
+	}
+	std::printf("simulated frames (%zu visible), ", visible.size());
+	heapCounter.report();
+	return 0;
+}
+
+//the usual scene graph, every node its own allocation with a vector of child pointers
+struct PointerNode
+{
+	Transform local;
+	Transform world;
+	PointerNode* parent = nullptr;
+	std::vector<PointerNode*> children;
+	bool dirty = true;
+};
+
+static void multiplyTransform(const Transform& a, const Transform& b, Transform& out)
+{
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			out.m[column * 4 + row] = a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1]
+				+ a.m[8 + row] * b.m[column * 4 + 2] + a.m[12 + row] * b.m[column * 4 + 3];
+}
+
+static uint32_t updatePointerNode(PointerNode* node, bool parentDirty)
+{
+	//has to visit every node to find the dirty ones
+	uint32_t updated = 0;
+	bool dirty = node->dirty || parentDirty;
+	if (dirty)
+	{
+		if (node->parent)
+			multiplyTransform(node->parent->world, node->local, node->world);
+		else
+			node->world = node->local;
+		node->dirty = false;
+		updated++;
+	}
+	for (PointerNode* child : node->children)
+		updated += updatePointerNode(child, dirty);
+	return updated;
+}
+
+static Transform randomTransform(std::mt19937& rng, float spread)
+{
+	//rotation about z, uniform scale, translation
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> offset(-spread, spread);
+	float a = angle(rng), c = std::cos(a) * 0.9f, s = std::sin(a) * 0.9f;
+	Transform t = { { c, s, 0.0f, 0.0f, -s, c, 0.0f, 0.0f, 0.0f, 0.0f, 0.9f, 0.0f, offset(rng), offset(rng), offset(rng), 1.0f } };
+	return t;
+}
+
+static int benchScene(int size)
+{
+	//objects of one root, 8 parts and 12 leaves per part
+	const int PARTS = 8, LEAVES = 12, NODES_PER_OBJECT = 1 + PARTS + PARTS * LEAVES;
+	int objects = std::max(1, (size > 0 ? size : 1000000) / NODES_PER_OBJECT);
+	int count = objects * NODES_PER_OBJECT;
+	std::mt19937 rng(99);
+
+	//built breadth first (every root, then every part, then every leaf) so the scene has to sort
+	std::vector<int> parentOf(count, -1);
+	std::vector<Transform> locals(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (i >= objects + objects * PARTS)
+			parentOf[i] = objects + (i - objects - objects * PARTS) / LEAVES;
+		else if (i >= objects)
+			parentOf[i] = (i - objects) / PARTS;
+		locals[i] = randomTransform(rng, parentOf[i] < 0 ? 100.0f : 1.0f);
+	}
+
+	std::vector<std::unique_ptr<PointerNode>> pointerNodes(count);
+	std::vector<PointerNode*> pointerRoots;
+	for (int i = 0; i < count; i++)
+	{
+		pointerNodes[i].reset(new PointerNode());
+		pointerNodes[i]->local = locals[i];
+		if (parentOf[i] >= 0)
+		{
+			pointerNodes[i]->parent = pointerNodes[parentOf[i]].get();
+			pointerNodes[parentOf[i]]->children.push_back(pointerNodes[i].get());
+		}
+		else
+			pointerRoots.push_back(pointerNodes[i].get());
+	}
+
+	Scene scene;
+	scene.reserve(count);
+	std::vector<NodeHandle> handles(count);
+	double createStart = nowMs();
+	for (int i = 0; i < count; i++)
+		handles[i] = scene.create(parentOf[i] >= 0 ? handles[parentOf[i]] : Scene::NO_NODE, locals[i].m);
+	double createMs = nowMs() - createStart;
+	double sortStart = nowMs();
+	scene.update();
+	std::printf("%d nodes (%d objects)  create %.3f ms  sort + first update %.3f ms\n", count, objects, createMs, nowMs() - sortStart);
+	for (PointerNode* root : pointerRoots)
+		updatePointerNode(root, false);
+
+	//each frame a few percent of the objects move, plus one reparented part
+	const int FRAMES = 20;
+	int moving = std::max(1, objects / 50);
+	std::vector<std::vector<int>> moves(FRAMES);
+	std::vector<Transform> moveTransforms(FRAMES * moving);
+	std::uniform_int_distribution<int> pickObject(0, objects - 1);
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		for (int i = 0; i < moving; i++)
+		{
+			moves[frame].push_back(pickObject(rng));
+			moveTransforms[frame * moving + i] = randomTransform(rng, 100.0f);
+		}
+	}
+
+	double pointerMs = 0.0;
+	uint32_t pointerUpdated = 0;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		double start = nowMs();
+		for (int i = 0; i < moving; i++)
+		{
+			PointerNode* node = pointerNodes[moves[frame][i]].get();
+			node->local = moveTransforms[frame * moving + i];
+			node->dirty = true;
+		}
+		for (PointerNode* root : pointerRoots)
+			pointerUpdated += updatePointerNode(root, false);
+		pointerMs += nowMs() - start;
+	}
+
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	JobSystem jobs;
+	jobs.init(maxThreads);
+	double sceneMs = 0.0;
+	uint32_t sceneUpdated = 0;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		double start = nowMs();
+		for (int i = 0; i < moving; i++)
+			scene.setLocal(handles[moves[frame][i]], moveTransforms[frame * moving + i].m);
+		sceneUpdated += scene.update(&jobs);
+		sceneMs += nowMs() - start;
+	}
+	std::printf("%d objects moving a frame  pointer graph %8.3f ms (%u nodes)  scene %8.3f ms (%u nodes)\n",
+		moving, pointerMs / FRAMES, pointerUpdated / FRAMES, sceneMs / FRAMES, sceneUpdated / FRAMES);
+
+	//everything moves, the split subtrees go wide
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem fullJobs;
+		fullJobs.init(threads);
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			for (int i = 0; i < objects; i++)
+				scene.setLocal(handles[i], pointerNodes[i]->local.m);
+			double start = nowMs();
+			scene.update(&fullJobs);
+			best = std::min(best, nowMs() - start);
+		}
+		std::printf("%2d threads  full update %8.3f ms\n", threads, best);
+	}
+
+	double pointerFull = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		for (PointerNode* root : pointerRoots)
+			root->dirty = true;
+		double start = nowMs();
+		for (PointerNode* root : pointerRoots)
+			updatePointerNode(root, false);
+		pointerFull = std::min(pointerFull, nowMs() - start);
+	}
+	std::printf("pointer graph full update %8.3f ms\n", pointerFull);
+
+	//move some parts to other objects, then both graphs have to agree
+	for (int i = 0; i < std::min(100, objects); i++)
+	{
+		int part = objects + pickObject(rng) * PARTS;
+		int object = pickObject(rng);
+		if (!scene.setParent(handles[part], handles[object]))
+			return -1;
+		PointerNode* node = pointerNodes[part].get();
+		std::vector<PointerNode*>& siblings = node->parent->children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), node));
+		node->parent = pointerNodes[object].get();
+		node->parent->children.push_back(node);
+		node->dirty = true;
+	}
+	double reparentStart = nowMs();
+	scene.update(&jobs);
+	double reparentMs = nowMs() - reparentStart;
+	for (PointerNode* root : pointerRoots)
+		updatePointerNode(root, false);
+
+	float maxError = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		const float* world = scene.getWorld(handles[i]);
+		for (int k = 0; k < 16; k++)
+			maxError = std::max(maxError, std::fabs(world[k] - pointerNodes[i]->world.m[k]));
+	}
+	std::printf("reparented parts, sort + update %.3f ms, largest difference from the pointer graph %g\n", reparentMs, maxError);
+	if (maxError > 1e-3f)
+	{
+		std::printf("ERROR scene transforms don't match the pointer graph\n");
+		return -1;
+	}
+
+	//a destroyed object takes its parts and leaves with it
+	size_t before = scene.size();
+	scene.destroy(handles[0]);
+	scene.update();
+	if (scene.size() != before - NODES_PER_OBJECT)
+	{
+		std::printf("ERROR destroying an object left %zu nodes, expected %zu\n", scene.size(), before - NODES_PER_OBJECT);
+		return -1;
+	}
+	return 0;
+}
+
+struct Position
+{
+	float x, y, z;
+};
+
+struct Velocity
+{
+	float x, y, z;
+};
+
+struct Health
+{
+	float value, regen;
+};
+
+//the bulk of a renderable that the gameplay systems don't touch
+struct RenderData
+{
+	float transform[16];
+	float colour[4];
+};
+
+//array of structs baseline, every object has every field whether it uses it or not
+struct GameObject
+{
+	Position position;
+	Velocity velocity;
+	Health health;
+	RenderData render;
+	bool moving;
+};
+
+static int benchEntities(int size)
+{
+	int count = size > 0 ? size : 200000;
+	const float DT = 1.0f / 60.0f;
+	const int FRAMES = 20;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> speed(-1.0f, 1.0f);
+
+	//every other object moves, one in four doesn't render
+	std::vector<GameObject> gameObjects(count);
+	EntityWorld world;
+	std::vector<Entity> entities(count);
+	double createStart = nowMs();
+	for (int i = 0; i < count; i++)
+	{
+		GameObject& object = gameObjects[i];
+		object.position = { (float)i, 0.0f, 0.0f };
+		object.velocity = { speed(rng), speed(rng), speed(rng) };
+		object.health = { (float)i, 1.0f };
+		object.render = {};
+		object.moving = (i & 1) == 0;
+
+		if (object.moving && i % 4 != 3)
+			entities[i] = world.create(object.position, object.velocity, object.health, object.render);
+		else if (object.moving)
+			entities[i] = world.create(object.position, object.velocity, object.health);
+		else if (i % 4 != 3)
+			entities[i] = world.create(object.position, object.health, object.render);
+		else
+			entities[i] = world.create(object.position, object.health);
+	}
+	std::printf("%d entities  created in %.3f ms  %zu archetypes  %zu chunks of %zu kb\n", count, nowMs() - createStart,
+		world.getArchetypeCount(), world.getChunkCount(), EntityWorld::CHUNK_SIZE / 1024);
+
+	//moving things between archetypes and destroying them has to keep every component with its entity
+	double structuralStart = nowMs();
+	for (int i = 1; i < count; i += 10)
+		world.add(entities[i], gameObjects[i].velocity);
+	for (int i = 1; i < count; i += 10)
+		world.remove<Velocity>(entities[i]);
+	for (int i = 5; i < count; i += 10)
+	{
+		world.destroy(entities[i]);
+		entities[i] = world.create(gameObjects[i].position, gameObjects[i].health);
+		if (gameObjects[i].moving)
+			world.add(entities[i], gameObjects[i].velocity);
+		if (i % 4 != 3)
+			world.add(entities[i], gameObjects[i].render);
+	}
+	double structuralMs = nowMs() - structuralStart;
+	for (int i = 0; i < count; i++)
+	{
+		const Health* health = world.get<Health>(entities[i]);
+		bool moving = world.has<Velocity>(entities[i]);
+		if (!health || health->value != (float)i || moving != gameObjects[i].moving)
+		{
+			std::printf("ERROR entity %d lost its components\n", i);
+			return -1;
+		}
+	}
+	std::printf("%d adds, removes and recreates in %.3f ms\n", count / 10 * 3, structuralMs);
+
+	//movement and regeneration, the two systems every frame
+	double aosMs = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		double start = nowMs();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			for (GameObject& object : gameObjects)
+			{
+				if (object.moving)
+				{
+					object.position.x += object.velocity.x * DT;
+					object.position.y += object.velocity.y * DT;
+					object.position.z += object.velocity.z * DT;
+				}
+				object.health.value += object.health.regen * DT;
+			}
+		}
+		aosMs = std::min(aosMs, (nowMs() - start) / FRAMES);
+	}
+
+	auto move = [DT](Position& position, const Velocity& velocity)
+	{
+		position.x += velocity.x * DT;
+		position.y += velocity.y * DT;
+		position.z += velocity.z * DT;
+	};
+	auto regenerate = [DT](Health& health)
+	{
+		health.value += health.regen * DT;
+	};
+
+	double ecsMs = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		double start = nowMs();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			world.each<Position, Velocity>(move);
+			world.each<Health>(regenerate);
+		}
+		ecsMs = std::min(ecsMs, (nowMs() - start) / FRAMES);
+	}
+	std::printf("array of structs %8.3f ms  entities %8.3f ms  (%.2fx)\n", aosMs, ecsMs, aosMs / ecsMs);
+
+	//both ran the same number of frames, so they have to agree
+	float maxError = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		const Position* position = world.get<Position>(entities[i]);
+		const Health* health = world.get<Health>(entities[i]);
+		maxError = std::max(maxError, std::fabs(health->value - gameObjects[i].health.value));
+		maxError = std::max(maxError, std::fabs(position->x - gameObjects[i].position.x));
+		maxError = std::max(maxError, std::fabs(position->y - gameObjects[i].position.y));
+	}
+	std::printf("largest difference from the array of structs %g\n", maxError);
+	if (maxError > 1e-3f)
+	{
+		std::printf("ERROR entities and array of structs disagree\n");
+		return -1;
+	}
+
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem jobs;
+		jobs.init(threads);
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			double start = nowMs();
+			for (int frame = 0; frame < FRAMES; frame++)
+			{
+				world.each<Position, Velocity>(jobs, move);
+				world.each<Health>(jobs, regenerate);
+			}
+			best = std::min(best, (nowMs() - start) / FRAMES);
+		}
+		std::printf("%2d threads  entities %8.3f ms\n", threads, best);
+	}
+
+	return 0;
+}
+
+int runBenchmark(const char* name, int size)
+{
+	if (std::strcmp(name, "mesh") == 0)
+		return benchMesh(size);
+	if (std::strcmp(name, "commands") == 0)
+		return benchCommands(size);
+	if (std::strcmp(name, "reflection") == 0)
+		return benchReflection(size);
+	if (std::strcmp(name, "culling") == 0)
+		return benchCulling(size);
+	if (std::strcmp(name, "bvh") == 0)
+		return benchBvh(size);
+	if (std::strcmp(name, "occlusion") == 0)
+		return benchOcclusion(size);
+	if (std::strcmp(name, "lod") == 0)
+		return benchLod(size);
+	if (std::strcmp(name, "jobs") == 0)
+		return benchJobs(size);
+	if (std::strcmp(name, "memory") == 0)
+		return benchMemory(size);
+	if (std::strcmp(name, "scene") == 0)
+		return benchScene(size);
+	if (std::strcmp(name, "entities") == 0)
+		return benchEntities(size);
+
+	std::printf("unknown benchmark %s\n", name);
+	return -1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//collects per-frame timings and reports min/median/p99
+class FrameSampler
+{
+public:
+	explicit FrameSampler(const char* name);
+
+	void reserve(size_t frames);
+	void add(double ms);
+	void report() const;
+
+	size_t count() const { return samples.size(); }
+
+private:
+	const char* name;
+	std::vector<double> samples;
+};
+
+//timer helpers on top of glfwGetTimerValue
+uint64_t timerNow();
+double timerMs(uint64_t start, uint64_t end);
+
+//cpu benchmarks that don't need a gl context, run with --bench <name> [size]
+int runBenchmark(const char* name, int size);
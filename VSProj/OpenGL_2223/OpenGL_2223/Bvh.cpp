@@ -0,0 +1,616 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BVH_SSE 1
+#include <immintrin.h>
+#endif
+
+static const int SAH_BINS = 16;
+//past this depth splits go down the middle so a bad sah split can't recurse forever
+static const int MAX_SAH_DEPTH = 48;
+//deepest a traversal stack can get, 3 pushes per level of 4-wide nodes
+static const int STACK_SIZE = 256;
+//relative costs for the sah, visiting a node vs testing one object
+static const float TRAVERSAL_COST = 1.0f;
+static const float INTERSECT_COST = 1.0f;
+
+static Aabb emptyBounds()
+{
+	return { { 1e30f, 1e30f, 1e30f }, { -1e30f, -1e30f, -1e30f } };
+}
+
+static void grow(Aabb& bounds, const Aabb& other)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = std::min(bounds.min[axis], other.min[axis]);
+		bounds.max[axis] = std::max(bounds.max[axis], other.max[axis]);
+	}
+}
+
+static float area(const Aabb& bounds)
+{
+	float x = bounds.max[0] - bounds.min[0], y = bounds.max[1] - bounds.min[1], z = bounds.max[2] - bounds.min[2];
+	if (x < 0.0f || y < 0.0f || z < 0.0f) return 0.0f;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+static float centroid(const Aabb& bounds, int axis)
+{
+	return (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+}
+
+static Aabb slotBounds(const BvhNode& node, int slot)
+{
+	return { { node.minX[slot], node.minY[slot], node.minZ[slot] }, { node.maxX[slot], node.maxY[slot], node.maxZ[slot] } };
+}
+
+static void setSlotBounds(BvhNode& node, int slot, const Aabb& bounds)
+{
+	node.minX[slot] = bounds.min[0];
+	node.minY[slot] = bounds.min[1];
+	node.minZ[slot] = bounds.min[2];
+	node.maxX[slot] = bounds.max[0];
+	node.maxY[slot] = bounds.max[1];
+	node.maxZ[slot] = bounds.max[2];
+}
+
+//binary sah tree, only used while building and then collapsed into 4-wide nodes
+struct BuildNode
+{
+	Aabb bounds;
+	int32_t left = -1, right = -1;	//-1 for leaves
+	uint32_t first = 0, count = 0;
+};
+
+static int32_t buildBinary(std::vector<BuildNode>& tree, const std::vector<Aabb>& objects, std::vector<uint32_t>& indices,
+	uint32_t first, uint32_t count, int depth)
+{
+	BuildNode node;
+	node.bounds = emptyBounds();
+	Aabb centroids = emptyBounds();
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Aabb& bounds = objects[indices[i]];
+		grow(node.bounds, bounds);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float c = centroid(bounds, axis);
+			centroids.min[axis] = std::min(centroids.min[axis], c);
+			centroids.max[axis] = std::max(centroids.max[axis], c);
+		}
+	}
+	node.first = first;
+	node.count = count;
+
+	int32_t index = (int32_t)tree.size();
+	tree.push_back(node);
+	if (count <= 1)
+		return index;
+
+	int axis = 0;
+	for (int a = 1; a < 3; a++)
+		if (centroids.max[a] - centroids.min[a] > centroids.max[axis] - centroids.min[axis]) axis = a;
+	float extent = centroids.max[axis] - centroids.min[axis];
+
+	uint32_t split = 0;
+	if (extent > 0.0f && depth < MAX_SAH_DEPTH)
+	{
+		//bin the centroids and sweep for the cheapest split plane
+		Aabb binBounds[SAH_BINS];
+		uint32_t binCount[SAH_BINS] = {};
+		for (Aabb& bounds : binBounds) bounds = emptyBounds();
+
+		float scale = SAH_BINS / extent;
+		auto binOf = [&](uint32_t object)
+		{
+			int bin = (int)((centroid(objects[object], axis) - centroids.min[axis]) * scale);
+			return std::min(bin, SAH_BINS - 1);
+		};
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			int bin = binOf(indices[i]);
+			grow(binBounds[bin], objects[indices[i]]);
+			binCount[bin]++;
+		}
+
+		float rightArea[SAH_BINS];
+		uint32_t rightCount[SAH_BINS];
+		Aabb right = emptyBounds();
+		uint32_t rightTotal = 0;
+		for (int bin = SAH_BINS - 1; bin > 0; bin--)
+		{
+			grow(right, binBounds[bin]);
+			rightTotal += binCount[bin];
+			rightArea[bin] = area(right);
+			rightCount[bin] = rightTotal;
+		}
+
+		float bestCost = 1e30f;
+		int bestBin = -1;
+		Aabb left = emptyBounds();
+		uint32_t leftTotal = 0;
+		for (int bin = 1; bin < SAH_BINS; bin++)
+		{
+			grow(left, binBounds[bin - 1]);
+			leftTotal += binCount[bin - 1];
+			if (leftTotal == 0 || rightCount[bin] == 0) continue;
+
+			float cost = area(left) * leftTotal + rightArea[bin] * rightCount[bin];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = bin;
+			}
+		}
+
+		//small enough and no split beats testing everything
+		float leafCost = area(node.bounds) * count * INTERSECT_COST;
+		float splitCost = area(node.bounds) * TRAVERSAL_COST + bestCost * INTERSECT_COST;
+		if (count <= (uint32_t)Bvh::MAX_LEAF_SIZE && (bestBin < 0 || leafCost <= splitCost))
+			return index;
+
+		if (bestBin > 0)
+		{
+			uint32_t* middle = std::partition(&indices[first], &indices[first] + count,
+				[&](uint32_t object) { return binOf(object) < bestBin; });
+			split = (uint32_t)(middle - &indices[first]);
+		}
+	}
+	else if (count <= (uint32_t)Bvh::MAX_LEAF_SIZE)
+	{
+		return index;
+	}
+
+	//every centroid in one bin (or too deep), fall back to an object median
+	if (split == 0 || split == count)
+	{
+		split = count / 2;
+		std::nth_element(&indices[first], &indices[first] + split, &indices[first] + count,
+			[&](uint32_t a, uint32_t b) { return centroid(objects[a], axis) < centroid(objects[b], axis); });
+	}
+
+	int32_t left = buildBinary(tree, objects, indices, first, split, depth + 1);
+	int32_t right = buildBinary(tree, objects, indices, first + split, count - split, depth + 1);
+	tree[index].left = left;
+	tree[index].right = right;
+	return index;
+}
+
+//pulls the binary node's grandchildren up until it has four children, depth first layout
+static int32_t collapse(const std::vector<BuildNode>& binary, int32_t root, std::vector<BvhNode>& nodes)
+{
+	int32_t index = (int32_t)nodes.size();
+	nodes.emplace_back();
+
+	int32_t children[4];
+	int childCount = 0;
+	if (binary[root].left < 0)
+	{
+		children[childCount++] = root;
+	}
+	else
+	{
+		children[childCount++] = binary[root].left;
+		children[childCount++] = binary[root].right;
+	}
+
+	//open the biggest inner child first, it's the one most likely to get visited
+	while (childCount < 4)
+	{
+		int best = -1;
+		float bestArea = -1.0f;
+		for (int i = 0; i < childCount; i++)
+		{
+			const BuildNode& child = binary[children[i]];
+			if (child.left >= 0 && area(child.bounds) > bestArea)
+			{
+				best = i;
+				bestArea = area(child.bounds);
+			}
+		}
+		if (best < 0) break;
+
+		int32_t opened = children[best];
+		children[best] = binary[opened].left;
+		children[childCount++] = binary[opened].right;
+	}
+
+	BvhNode node;
+	for (int slot = 0; slot < 4; slot++)
+	{
+		node.child[slot] = -1;
+		node.count[slot] = 0;
+		setSlotBounds(node, slot, emptyBounds());
+	}
+	for (int slot = 0; slot < childCount; slot++)
+	{
+		const BuildNode& child = binary[children[slot]];
+		setSlotBounds(node, slot, child.bounds);
+		if (child.left < 0)
+		{
+			node.child[slot] = (int32_t)child.first;
+			node.count[slot] = (int32_t)child.count;
+		}
+		else
+		{
+			node.child[slot] = collapse(binary, children[slot], nodes);
+		}
+	}
+	//nodes may have grown, write by index
+	nodes[index] = node;
+	return index;
+}
+
+Bvh::Tree Bvh::buildTree(const std::vector<Aabb>& objects)
+{
+	Tree tree;
+	if (objects.empty())
+		return tree;
+
+	tree.objectIndices.resize(objects.size());
+	for (uint32_t i = 0; i < objects.size(); i++)
+		tree.objectIndices[i] = i;
+
+	std::vector<BuildNode> binary;
+	binary.reserve(objects.size() * 2);
+	buildBinary(binary, objects, tree.objectIndices, 0, (uint32_t)objects.size(), 0);
+
+	tree.nodes.reserve(binary.size() / 2 + 1);
+	collapse(binary, 0, tree.nodes);
+	tree.cost = computeCost(tree.nodes);
+	return tree;
+}
+
+float Bvh::computeCost(const std::vector<BvhNode>& nodes)
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	Aabb root = emptyBounds();
+	for (int slot = 0; slot < 4; slot++)
+		if (nodes[0].child[slot] >= 0) grow(root, slotBounds(nodes[0], slot));
+	float rootArea = area(root);
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	//expected cost of a random ray, proportional to surface area
+	float cost = 0.0f;
+	for (const BvhNode& node : nodes)
+	{
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] < 0) continue;
+			float slotCost = node.count[slot] > 0 ? node.count[slot] * INTERSECT_COST : TRAVERSAL_COST;
+			cost += area(slotBounds(node, slot)) * slotCost;
+		}
+	}
+	return cost / rootArea;
+}
+
+void Bvh::build(const std::vector<Aabb>& newObjects)
+{
+	//a rebuild of the old object set is useless now
+	if (rebuild.valid())
+		rebuild.wait();
+	rebuild = std::future<Tree>();
+
+	objects = newObjects;
+	Tree tree = buildTree(objects);
+	nodes = std::move(tree.nodes);
+	objectIndices = std::move(tree.objectIndices);
+	cost = builtCost = tree.cost;
+}
+
+void Bvh::refit()
+{
+	//children always come after their parent, so going backwards sees them first
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		BvhNode& node = nodes[i];
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] < 0) continue;
+
+			Aabb bounds = emptyBounds();
+			if (node.count[slot] > 0)
+			{
+				for (int32_t o = 0; o < node.count[slot]; o++)
+					grow(bounds, objects[objectIndices[node.child[slot] + o]]);
+			}
+			else
+			{
+				const BvhNode& child = nodes[node.child[slot]];
+				for (int childSlot = 0; childSlot < 4; childSlot++)
+					if (child.child[childSlot] >= 0) grow(bounds, slotBounds(child, childSlot));
+			}
+			setSlotBounds(node, slot, bounds);
+		}
+	}
+	cost = computeCost(nodes);
+}
+
+void Bvh::rebuildAsync()
+{
+	if (rebuild.valid())
+		return;
+
+	//the worker builds from a snapshot, the live bounds keep moving meanwhile
+	rebuild = std::async(std::launch::async, [snapshot = objects]() { return buildTree(snapshot); });
+}
+
+bool Bvh::pollRebuild()
+{
+	if (!rebuild.valid() || rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	Tree tree = rebuild.get();
+	nodes = std::move(tree.nodes);
+	objectIndices = std::move(tree.objectIndices);
+	builtCost = tree.cost;
+	//objects moved while the worker was busy
+	refit();
+	return true;
+}
+
+static int validSlots(const BvhNode& node)
+{
+	int mask = 0;
+	for (int slot = 0; slot < 4; slot++)
+		if (node.child[slot] >= 0) mask |= 1 << slot;
+	return mask;
+}
+
+//4-wide plane tests: visible where the box's positive vertex is inside every plane,
+//contained where even the negative vertex is
+static void testFrustum(const BvhNode& node, const Frustum& frustum, int& visible, int& contained)
+{
+#ifdef BVH_SSE
+	__m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+	__m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 whole = inside;
+	const __m128 zero = _mm_setzero_ps();
+
+	for (const float* plane : frustum.planes)
+	{
+		__m128 a = _mm_set1_ps(plane[0]), b = _mm_set1_ps(plane[1]), c = _mm_set1_ps(plane[2]), d = _mm_set1_ps(plane[3]);
+		__m128 px = plane[0] >= 0.0f ? maxX : minX, nx = plane[0] >= 0.0f ? minX : maxX;
+		__m128 py = plane[1] >= 0.0f ? maxY : minY, ny = plane[1] >= 0.0f ? minY : maxY;
+		__m128 pz = plane[2] >= 0.0f ? maxZ : minZ, nz = plane[2] >= 0.0f ? minZ : maxZ;
+
+		__m128 dp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, px), _mm_mul_ps(b, py)), _mm_add_ps(_mm_mul_ps(c, pz), d));
+		__m128 dn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, nx), _mm_mul_ps(b, ny)), _mm_add_ps(_mm_mul_ps(c, nz), d));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(dp, zero));
+		whole = _mm_and_ps(whole, _mm_cmpge_ps(dn, zero));
+	}
+	visible = _mm_movemask_ps(inside) & validSlots(node);
+	contained = _mm_movemask_ps(whole) & visible;
+#else
+	visible = contained = 0;
+	for (int slot = 0; slot < 4; slot++)
+	{
+		if (node.child[slot] < 0) continue;
+		bool in = true, all = true;
+		for (const float* plane : frustum.planes)
+		{
+			float dp = plane[0] * (plane[0] >= 0.0f ? node.maxX[slot] : node.minX[slot]) + plane[1] * (plane[1] >= 0.0f ? node.maxY[slot] : node.minY[slot])
+				+ plane[2] * (plane[2] >= 0.0f ? node.maxZ[slot] : node.minZ[slot]) + plane[3];
+			float dn = plane[0] * (plane[0] >= 0.0f ? node.minX[slot] : node.maxX[slot]) + plane[1] * (plane[1] >= 0.0f ? node.minY[slot] : node.maxY[slot])
+				+ plane[2] * (plane[2] >= 0.0f ? node.minZ[slot] : node.maxZ[slot]) + plane[3];
+			in &= dp >= 0.0f;
+			all &= dn >= 0.0f;
+		}
+		visible |= in << slot;
+		contained |= (in && all) << slot;
+	}
+#endif
+}
+
+//same test as CullingSet::cullBoxes so the results match the flat path exactly
+static bool boxInFrustum(const Aabb& box, const Frustum& frustum)
+{
+	for (const float* plane : frustum.planes)
+	{
+		float px = plane[0] >= 0.0f ? box.max[0] : box.min[0];
+		float py = plane[1] >= 0.0f ? box.max[1] : box.min[1];
+		float pz = plane[2] >= 0.0f ? box.max[2] : box.min[2];
+		if (plane[0] * px + plane[1] * py + plane[2] * pz + plane[3] < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void Bvh::addSubtree(int32_t root, std::vector<uint32_t>& result) const
+{
+	int32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0)
+	{
+		const BvhNode& node = nodes[stack[--top]];
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] < 0) continue;
+			if (node.count[slot] > 0)
+				result.insert(result.end(), &objectIndices[node.child[slot]], &objectIndices[node.child[slot]] + node.count[slot]);
+			else
+				stack[top++] = node.child[slot];
+		}
+	}
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+	result.clear();
+	if (nodes.empty())
+		return;
+
+	int32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BvhNode& node = nodes[stack[--top]];
+		int visible, contained;
+		testFrustum(node, frustum, visible, contained);
+
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (!(visible & (1 << slot))) continue;
+			bool whole = (contained & (1 << slot)) != 0;
+
+			if (node.count[slot] > 0)
+			{
+				const uint32_t* leaf = &objectIndices[node.child[slot]];
+				for (int32_t o = 0; o < node.count[slot]; o++)
+					if (whole || boxInFrustum(objects[leaf[o]], frustum)) result.push_back(leaf[o]);
+			}
+			else if (whole)
+			{
+				//nothing below can be outside, skip the plane tests
+				addSubtree(node.child[slot], result);
+			}
+			else
+			{
+				stack[top++] = node.child[slot];
+			}
+		}
+	}
+}
+
+static bool boxTouchesSphere(const Aabb& box, const float center[3], float radius)
+{
+	float distance = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float d = std::max(std::max(box.min[axis] - center[axis], center[axis] - box.max[axis]), 0.0f);
+		distance += d * d;
+	}
+	return distance <= radius * radius;
+}
+
+void Bvh::querySphere(const float center[3], float radius, std::vector<uint32_t>& result) const
+{
+	result.clear();
+	if (nodes.empty())
+		return;
+
+	int32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BvhNode& node = nodes[stack[--top]];
+
+		int touching = 0;
+#ifdef BVH_SSE
+		const __m128 zero = _mm_setzero_ps();
+		__m128 cx = _mm_set1_ps(center[0]), cy = _mm_set1_ps(center[1]), cz = _mm_set1_ps(center[2]);
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minX), cx), _mm_sub_ps(cx, _mm_load_ps(node.maxX))), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minY), cy), _mm_sub_ps(cy, _mm_load_ps(node.maxY))), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minZ), cz), _mm_sub_ps(cz, _mm_load_ps(node.maxZ))), zero);
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		touching = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radius * radius))) & validSlots(node);
+#else
+		for (int slot = 0; slot < 4; slot++)
+			if (node.child[slot] >= 0 && boxTouchesSphere(slotBounds(node, slot), center, radius)) touching |= 1 << slot;
+#endif
+
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (!(touching & (1 << slot))) continue;
+			if (node.count[slot] > 0)
+			{
+				const uint32_t* leaf = &objectIndices[node.child[slot]];
+				for (int32_t o = 0; o < node.count[slot]; o++)
+					if (boxTouchesSphere(objects[leaf[o]], center, radius)) result.push_back(leaf[o]);
+			}
+			else
+			{
+				stack[top++] = node.child[slot];
+			}
+		}
+	}
+}
+
+//slab test, returns the entry distance or -1 for a miss
+static float rayBox(const Aabb& box, const float origin[3], const float inverse[3], float maxT)
+{
+	float tMin = 0.0f, tMax = maxT;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t1 = (box.min[axis] - origin[axis]) * inverse[axis];
+		float t2 = (box.max[axis] - origin[axis]) * inverse[axis];
+		tMin = std::max(tMin, std::min(t1, t2));
+		tMax = std::min(tMax, std::max(t1, t2));
+	}
+	return tMin <= tMax ? tMin : -1.0f;
+}
+
+BvhHit Bvh::raycast(const float origin[3], const float direction[3], float maxT) const
+{
+	BvhHit hit;
+	if (nodes.empty())
+		return hit;
+
+	//1/0 = inf keeps the slab maths right for axis aligned rays
+	float inverse[3];
+	for (int axis = 0; axis < 3; axis++)
+		inverse[axis] = 1.0f / direction[axis];
+	float best = maxT;
+
+	int32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BvhNode& node = nodes[stack[--top]];
+
+		int hits = 0;
+#ifdef BVH_SSE
+		__m128 tMin = _mm_setzero_ps(), tMax = _mm_set1_ps(best);
+		const float* mins[3] = { node.minX, node.minY, node.minZ };
+		const float* maxs[3] = { node.maxX, node.maxY, node.maxZ };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128 o = _mm_set1_ps(origin[axis]), inv = _mm_set1_ps(inverse[axis]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(mins[axis]), o), inv);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(maxs[axis]), o), inv);
+			tMin = _mm_max_ps(tMin, _mm_min_ps(t1, t2));
+			tMax = _mm_min_ps(tMax, _mm_max_ps(t1, t2));
+		}
+		hits = _mm_movemask_ps(_mm_cmple_ps(tMin, tMax)) & validSlots(node);
+#else
+		for (int slot = 0; slot < 4; slot++)
+			if (node.child[slot] >= 0 && rayBox(slotBounds(node, slot), origin, inverse, best) >= 0.0f) hits |= 1 << slot;
+#endif
+
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (!(hits & (1 << slot))) continue;
+			if (node.count[slot] > 0)
+			{
+				const uint32_t* leaf = &objectIndices[node.child[slot]];
+				for (int32_t o = 0; o < node.count[slot]; o++)
+				{
+					float t = rayBox(objects[leaf[o]], origin, inverse, best);
+					if (t >= 0.0f && t < best)
+					{
+						best = t;
+						hit.object = (int32_t)leaf[o];
+						hit.t = t;
+					}
+				}
+			}
+			else
+			{
+				stack[top++] = node.child[slot];
+			}
+		}
+	}
+	return hit;
+}
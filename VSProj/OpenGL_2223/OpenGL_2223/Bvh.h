@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "Culling.h"
+
+//four children's boxes side by side (structure of arrays) so one node is tested with
+//a single 4-wide pass. 128 bytes, two cache lines, nodes are stored depth first
+struct alignas(64) BvhNode
+{
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	int32_t child[4];	//node index, first primitive for leaves, -1 for an empty slot
+	int32_t count[4];	//primitives in a leaf slot, 0 for inner nodes
+};
+static_assert(sizeof(BvhNode) == 128, "bvh node should stay two cache lines");
+
+struct BvhHit
+{
+	int32_t object = -1;	//-1 when nothing was hit
+	float t = 0.0f;			//distance along the ray in units of the direction's length
+};
+
+//4-wide bounding volume hierarchy over object aabbs, built with binned sah.
+//objects that move get refit() (cheap, keeps the topology), and once refitting has made
+//the tree noticeably worse rebuildAsync() builds a fresh one on a worker thread and
+//pollRebuild() swaps it in between frames
+class Bvh
+{
+public:
+	void build(const std::vector<Aabb>& objects);
+
+	//move objects, then refit once
+	void setBounds(uint32_t object, const Aabb& bounds) { objects[object] = bounds; }
+	void refit();
+
+	//sah cost of the current tree relative to right after the last build, 1 = as built
+	float getQualityRatio() const { return builtCost > 0.0f ? cost / builtCost : 1.0f; }
+
+	//starts a rebuild from the current bounds unless one is already running
+	void rebuildAsync();
+	//swaps in a finished rebuild (refit to whatever moved since it started), true if it did
+	bool pollRebuild();
+	bool isRebuilding() const { return rebuild.valid(); }
+
+	//indices of objects whose aabbs may be in the frustum, in no particular order
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+	//objects whose aabbs touch the sphere
+	void querySphere(const float center[3], float radius, std::vector<uint32_t>& result) const;
+	//nearest aabb along the ray, for picking
+	BvhHit raycast(const float origin[3], const float direction[3], float maxT = 1e30f) const;
+
+	size_t getNodeCount() const { return nodes.size(); }
+	size_t getObjectCount() const { return objects.size(); }
+
+	static const int MAX_LEAF_SIZE = 4;
+
+private:
+	struct Tree
+	{
+		std::vector<BvhNode> nodes;
+		std::vector<uint32_t> objectIndices;	//leaves point into this
+		float cost = 0.0f;
+	};
+
+	static Tree buildTree(const std::vector<Aabb>& objects);
+	static float computeCost(const std::vector<BvhNode>& nodes);
+	void addSubtree(int32_t node, std::vector<uint32_t>& result) const;
+
+	std::vector<Aabb> objects;
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> objectIndices;
+	float cost = 0.0f;
+	float builtCost = 0.0f;
+
+	std::future<Tree> rebuild;
+};
@@ -0,0 +1,203 @@
+#include "CommandBuffer.h"
+
+#include "UniformBuffer.h"
+
+#include <cstring>
+#include <type_traits>
+
+template<typename T> T* CommandBuffer::push(CommandType type)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "commands are copied around as raw bytes");
+	static_assert(sizeof(T) <= BLOCK_SIZE, "command doesn't fit in a block");
+
+	const size_t size = (sizeof(T) + COMMAND_ALIGNMENT - 1) & ~(COMMAND_ALIGNMENT - 1);
+
+	//move on to the next block (reusing it from an earlier frame if there is one)
+	if (blocks.empty() || blocks[currentBlock].used + size > BLOCK_SIZE)
+	{
+		if (!blocks.empty())
+			currentBlock++;
+		if (currentBlock == blocks.size())
+		{
+			Block block;
+			block.data.reset(new unsigned char[BLOCK_SIZE]);
+			blocks.push_back(std::move(block));
+		}
+	}
+
+	Block& block = blocks[currentBlock];
+	T* command = reinterpret_cast<T*>(block.data.get() + block.used);
+	block.used += size;
+	commandCount++;
+
+	command->header.type = type;
+	command->header.size = (uint16_t)size;
+	return command;
+}
+
+void CommandBuffer::reset()
+{
+	for (Block& block : blocks)
+		block.used = 0;
+	currentBlock = 0;
+	commandCount = 0;
+}
+
+size_t CommandBuffer::getBytes() const
+{
+	size_t bytes = 0;
+	for (const Block& block : blocks)
+		bytes += block.used;
+	return bytes;
+}
+
+void CommandBuffer::clear(GLbitfield mask, float r, float g, float b, float a)
+{
+	CmdClear* cmd = push<CmdClear>(CMD_CLEAR);
+	cmd->mask = mask;
+	cmd->colour[0] = r;
+	cmd->colour[1] = g;
+	cmd->colour[2] = b;
+	cmd->colour[3] = a;
+}
+
+void CommandBuffer::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	CmdViewport* cmd = push<CmdViewport>(CMD_VIEWPORT);
+	cmd->x = x;
+	cmd->y = y;
+	cmd->width = width;
+	cmd->height = height;
+}
+
+void CommandBuffer::useProgram(GLuint program)
+{
+	push<CmdUseProgram>(CMD_USE_PROGRAM)->program = program;
+}
+
+void CommandBuffer::bindVertexArray(GLuint vao)
+{
+	push<CmdBindVAO>(CMD_BIND_VAO)->vao = vao;
+}
+
+void CommandBuffer::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	CmdBindTexture* cmd = push<CmdBindTexture>(CMD_BIND_TEXTURE);
+	cmd->unit = unit;
+	cmd->target = target;
+	cmd->texture = texture;
+}
+
+void CommandBuffer::uniform4f(GLint location, float x, float y, float z, float w)
+{
+	CmdUniform4f* cmd = push<CmdUniform4f>(CMD_UNIFORM_4F);
+	cmd->location = location;
+	cmd->value[0] = x;
+	cmd->value[1] = y;
+	cmd->value[2] = z;
+	cmd->value[3] = w;
+}
+
+void CommandBuffer::uniformMatrix4(GLint location, const float* columnMajor)
+{
+	CmdUniformMatrix4* cmd = push<CmdUniformMatrix4>(CMD_UNIFORM_MATRIX4);
+	cmd->location = location;
+	std::memcpy(cmd->value, columnMajor, sizeof(cmd->value));
+}
+
+void CommandBuffer::draw(const DrawPacket& packet)
+{
+	push<CmdDraw>(CMD_DRAW)->packet = packet;
+}
+
+void CommandBuffer::replay() const
+{
+	//binds go straight to gl, the state cache drops the ones that change nothing
+	for (size_t b = 0; b <= currentBlock && b < blocks.size(); b++)
+	{
+		const unsigned char* data = blocks[b].data.get();
+		const unsigned char* end = data + blocks[b].used;
+
+		while (data < end)
+		{
+			const CommandHeader* header = reinterpret_cast<const CommandHeader*>(data);
+			switch (header->type)
+			{
+			case CMD_CLEAR:
+			{
+				const CmdClear* cmd = reinterpret_cast<const CmdClear*>(data);
+				glClearColor(cmd->colour[0], cmd->colour[1], cmd->colour[2], cmd->colour[3]);
+				glClear(cmd->mask);
+				break;
+			}
+			case CMD_VIEWPORT:
+			{
+				const CmdViewport* cmd = reinterpret_cast<const CmdViewport*>(data);
+				glViewport(cmd->x, cmd->y, cmd->width, cmd->height);
+				break;
+			}
+			case CMD_USE_PROGRAM:
+				glUseProgram(reinterpret_cast<const CmdUseProgram*>(data)->program);
+				break;
+			case CMD_BIND_VAO:
+				glBindVertexArray(reinterpret_cast<const CmdBindVAO*>(data)->vao);
+				break;
+			case CMD_BIND_TEXTURE:
+			{
+				const CmdBindTexture* cmd = reinterpret_cast<const CmdBindTexture*>(data);
+				glActiveTexture(GL_TEXTURE0 + cmd->unit);
+				glBindTexture(cmd->target, cmd->texture);
+				break;
+			}
+			case CMD_UNIFORM_4F:
+			{
+				const CmdUniform4f* cmd = reinterpret_cast<const CmdUniform4f*>(data);
+				glUniform4fv(cmd->location, 1, cmd->value);
+				break;
+			}
+			case CMD_UNIFORM_MATRIX4:
+			{
+				const CmdUniformMatrix4* cmd = reinterpret_cast<const CmdUniformMatrix4*>(data);
+				glUniformMatrix4fv(cmd->location, 1, GL_FALSE, cmd->value);
+				break;
+			}
+			case CMD_DRAW:
+			{
+				const DrawPacket& packet = reinterpret_cast<const CmdDraw*>(data)->packet;
+				glUseProgram(packet.program);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, packet.material);
+				glBindVertexArray(packet.vao);
+				if (packet.uniformSize > 0)
+					glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORM_BINDING, packet.uniformBuffer, packet.uniformOffset, packet.uniformSize);
+				RenderQueue::draw(packet);
+				break;
+			}
+			}
+			data += header->size;
+		}
+	}
+}
+
+void CommandQueue::begin(size_t count)
+{
+	if (buffers.size() < count)
+		buffers.resize(count);
+	for (size_t i = 0; i < count; i++)
+		buffers[i].reset();
+	activeCount = count;
+}
+
+void CommandQueue::replay() const
+{
+	for (size_t i = 0; i < activeCount; i++)
+		buffers[i].replay();
+}
+
+size_t CommandQueue::getCommandCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < activeCount; i++)
+		count += buffers[i].getCommandCount();
+	return count;
+}
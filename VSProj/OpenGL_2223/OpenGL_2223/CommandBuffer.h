@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+
+//cpu side gl command recording. any thread can record into its own CommandBuffer
+//without touching gl, the thread that owns the context replays them later.
+//commands are POD structs packed back to back into arena blocks that are kept
+//between frames, so recording a steady frame doesn't allocate.
+
+enum CommandType : uint16_t
+{
+	CMD_CLEAR,
+	CMD_VIEWPORT,
+	CMD_USE_PROGRAM,
+	CMD_BIND_VAO,
+	CMD_BIND_TEXTURE,
+	CMD_UNIFORM_4F,
+	CMD_UNIFORM_MATRIX4,
+	CMD_DRAW
+};
+
+struct CommandHeader
+{
+	uint16_t type;
+	uint16_t size;	//whole command including the header
+};
+
+struct CmdClear { CommandHeader header; GLbitfield mask; float colour[4]; };
+struct CmdViewport { CommandHeader header; GLint x, y; GLsizei width, height; };
+struct CmdUseProgram { CommandHeader header; GLuint program; };
+struct CmdBindVAO { CommandHeader header; GLuint vao; };
+struct CmdBindTexture { CommandHeader header; GLuint unit; GLenum target; GLuint texture; };
+struct CmdUniform4f { CommandHeader header; GLint location; float value[4]; };
+struct CmdUniformMatrix4 { CommandHeader header; GLint location; float value[16]; };
+struct CmdDraw { CommandHeader header; DrawPacket packet; };
+
+class CommandBuffer
+{
+public:
+	static const size_t BLOCK_SIZE = 64 * 1024;
+	static const size_t COMMAND_ALIGNMENT = 8;
+
+	//forget the commands, keeps the blocks
+	void reset();
+
+	void clear(GLbitfield mask, float r, float g, float b, float a);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	void uniform4f(GLint location, float x, float y, float z, float w);
+	void uniformMatrix4(GLint location, const float* columnMajor);
+	//binds the packet's program, material and vao then draws
+	void draw(const DrawPacket& packet);
+
+	//context thread only
+	void replay() const;
+
+	size_t getCommandCount() const { return commandCount; }
+	size_t getBytes() const;
+
+private:
+	template<typename T> T* push(CommandType type);
+
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t used = 0;
+	};
+
+	std::vector<Block> blocks;
+	size_t currentBlock = 0;
+	size_t commandCount = 0;
+};
+
+//a frame's command buffers, one per recording task. replay runs them in index order,
+//so the result matches recording everything serially no matter which thread finished first
+class CommandQueue
+{
+public:
+	//grows to at least count buffers and resets them all
+	void begin(size_t count);
+	CommandBuffer& get(size_t index) { return buffers[index]; }
+	size_t size() const { return activeCount; }
+
+	//context thread only, after every recorder is done
+	void replay() const;
+
+	size_t getCommandCount() const;
+
+private:
+	std::vector<CommandBuffer> buffers;
+	size_t activeCount = 0;
+};
@@ -0,0 +1,339 @@
+#include "Culling.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+//msvc emits avx code for the intrinsics without /arch, the runtime check guards it
+#define CULL_TARGET_AVX2
+#else
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+Frustum makeFrustum(const float* m)
+{
+	//row i of the column-major matrix is m[i], m[4 + i], m[8 + i], m[12 + i]
+	Frustum frustum;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			frustum.planes[i * 2 + 0][c] = m[c * 4 + 3] + m[c * 4 + i];
+			frustum.planes[i * 2 + 1][c] = m[c * 4 + 3] - m[c * 4 + i];
+		}
+	}
+
+	for (float* plane : frustum.planes)
+	{
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+			for (int c = 0; c < 4; c++) plane[c] /= length;
+	}
+	return frustum;
+}
+
+CullKernel bestCullKernel()
+{
+#ifdef CULL_X86
+	static const CullKernel best = []
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		//the os has to save the ymm registers too
+		if (osxsave && avx2 && (_xgetbv(0) & 6) == 6)
+			return CullKernel::AVX2;
+#else
+		if (__builtin_cpu_supports("avx2"))
+			return CullKernel::AVX2;
+#endif
+		return CullKernel::SSE;
+	}();
+	return best;
+#else
+	return CullKernel::Scalar;
+#endif
+}
+
+const char* cullKernelName(CullKernel kernel)
+{
+	switch (kernel)
+	{
+	case CullKernel::SSE: return "sse";
+	case CullKernel::AVX2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+void CullingSet::reserve(size_t count)
+{
+	for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		array->reserve(count);
+}
+
+void CullingSet::clear()
+{
+	for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		array->clear();
+}
+
+uint32_t CullingSet::add(const float center[3], float sphereRadius, const float boundsMin[3], const float boundsMax[3])
+{
+	uint32_t index = (uint32_t)radius.size();
+	centerX.push_back(center[0]);
+	centerY.push_back(center[1]);
+	centerZ.push_back(center[2]);
+	radius.push_back(sphereRadius);
+	minX.push_back(boundsMin[0]);
+	minY.push_back(boundsMin[1]);
+	minZ.push_back(boundsMin[2]);
+	maxX.push_back(boundsMax[0]);
+	maxY.push_back(boundsMax[1]);
+	maxZ.push_back(boundsMax[2]);
+	return index;
+}
+
+void CullingSet::setSphere(uint32_t index, const float center[3], float sphereRadius)
+{
+	centerX[index] = center[0];
+	centerY[index] = center[1];
+	centerZ[index] = center[2];
+	radius[index] = sphereRadius;
+}
+
+void CullingSet::setBounds(uint32_t index, const float boundsMin[3], const float boundsMax[3])
+{
+	minX[index] = boundsMin[0];
+	minY[index] = boundsMin[1];
+	minZ[index] = boundsMin[2];
+	maxX[index] = boundsMax[0];
+	maxY[index] = boundsMax[1];
+	maxZ[index] = boundsMax[2];
+}
+
+//the kernels cover [begin, end) and append to out, returning the new count.
+//indices are written unconditionally and the count only moves for visible ones,
+//so compaction doesn't branch on the test result
+
+static size_t spheresScalar(const float* x, const float* y, const float* z, const float* r,
+	size_t begin, size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (const float* plane : frustum.planes)
+			inside &= plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + plane[3] >= -r[i];
+		out[count] = (uint32_t)i;
+		count += inside;
+	}
+	return count;
+}
+
+//positive vertex test: per plane only the aabb corner furthest along the normal matters
+static size_t boxesScalar(const float* const* lo, const float* const* hi,
+	size_t begin, size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (const float* plane : frustum.planes)
+		{
+			float px = plane[0] >= 0.0f ? hi[0][i] : lo[0][i];
+			float py = plane[1] >= 0.0f ? hi[1][i] : lo[1][i];
+			float pz = plane[2] >= 0.0f ? hi[2][i] : lo[2][i];
+			inside &= plane[0] * px + plane[1] * py + plane[2] * pz + plane[3] >= 0.0f;
+		}
+		out[count] = (uint32_t)i;
+		count += inside;
+	}
+	return count;
+}
+
+#ifdef CULL_X86
+static size_t compact4(int mask, size_t i, uint32_t* out, size_t count)
+{
+	for (int lane = 0; lane < 4; lane++)
+	{
+		out[count] = (uint32_t)(i + lane);
+		count += (mask >> lane) & 1;
+	}
+	return count;
+}
+
+static size_t spheresSSE(const float* x, const float* y, const float* z, const float* r,
+	size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++) planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i + 4 <= end; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+		__m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(r + i));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], cx), _mm_mul_ps(planes[p][1], cy)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], cz), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+		count = compact4(_mm_movemask_ps(inside), i, out, count);
+	}
+	return count;
+}
+
+static size_t boxesSSE(const float* const* lo, const float* const* hi,
+	size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	__m128 planes[6][4];
+	const float* corner[6][3];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int c = 0; c < 4; c++) planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		//the plane is the same for every object, so pick the corner arrays once
+		for (int axis = 0; axis < 3; axis++) corner[p][axis] = frustum.planes[p][axis] >= 0.0f ? hi[axis] : lo[axis];
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i + 4 <= end; i += 4)
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], _mm_loadu_ps(corner[p][0] + i)), _mm_mul_ps(planes[p][1], _mm_loadu_ps(corner[p][1] + i))),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], _mm_loadu_ps(corner[p][2] + i)), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+		}
+		count = compact4(_mm_movemask_ps(inside), i, out, count);
+	}
+	return count;
+}
+
+CULL_TARGET_AVX2 static size_t spheresAVX2(const float* x, const float* y, const float* z, const float* r,
+	size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++) planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+
+	const __m256 zero = _mm256_setzero_ps();
+	for (size_t i = 0; i + 8 <= end; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(x + i), cy = _mm256_loadu_ps(y + i), cz = _mm256_loadu_ps(z + i);
+		__m256 negR = _mm256_sub_ps(zero, _mm256_loadu_ps(r + i));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], cx), _mm256_mul_ps(planes[p][1], cy)),
+				_mm256_add_ps(_mm256_mul_ps(planes[p][2], cz), planes[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			out[count] = (uint32_t)(i + lane);
+			count += (mask >> lane) & 1;
+		}
+	}
+	return count;
+}
+
+CULL_TARGET_AVX2 static size_t boxesAVX2(const float* const* lo, const float* const* hi,
+	size_t end, const Frustum& frustum, uint32_t* out, size_t count)
+{
+	__m256 planes[6][4];
+	const float* corner[6][3];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int c = 0; c < 4; c++) planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+		for (int axis = 0; axis < 3; axis++) corner[p][axis] = frustum.planes[p][axis] >= 0.0f ? hi[axis] : lo[axis];
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	for (size_t i = 0; i + 8 <= end; i += 8)
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], _mm256_loadu_ps(corner[p][0] + i)), _mm256_mul_ps(planes[p][1], _mm256_loadu_ps(corner[p][1] + i))),
+				_mm256_add_ps(_mm256_mul_ps(planes[p][2], _mm256_loadu_ps(corner[p][2] + i)), planes[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			out[count] = (uint32_t)(i + lane);
+			count += (mask >> lane) & 1;
+		}
+	}
+	return count;
+}
+#endif
+
+void CullingSet::cullSpheres(const Frustum& frustum, std::vector<uint32_t>& visible, CullKernel kernel) const
+{
+	size_t n = size();
+	visible.resize(n);
+	uint32_t* out = visible.data();
+	size_t count = 0, done = 0;
+
+#ifdef CULL_X86
+	if (kernel == CullKernel::AVX2)
+	{
+		done = n & ~(size_t)7;
+		count = spheresAVX2(centerX.data(), centerY.data(), centerZ.data(), radius.data(), done, frustum, out, count);
+	}
+	else if (kernel == CullKernel::SSE)
+	{
+		done = n & ~(size_t)3;
+		count = spheresSSE(centerX.data(), centerY.data(), centerZ.data(), radius.data(), done, frustum, out, count);
+	}
+#else
+	(void)kernel;
+#endif
+
+	count = spheresScalar(centerX.data(), centerY.data(), centerZ.data(), radius.data(), done, n, frustum, out, count);
+	visible.resize(count);
+}
+
+void CullingSet::cullBoxes(const Frustum& frustum, std::vector<uint32_t>& visible, CullKernel kernel) const
+{
+	size_t n = size();
+	visible.resize(n);
+	uint32_t* out = visible.data();
+	size_t count = 0, done = 0;
+
+	const float* lo[3] = { minX.data(), minY.data(), minZ.data() };
+	const float* hi[3] = { maxX.data(), maxY.data(), maxZ.data() };
+
+#ifdef CULL_X86
+	if (kernel == CullKernel::AVX2)
+	{
+		done = n & ~(size_t)7;
+		count = boxesAVX2(lo, hi, done, frustum, out, count);
+	}
+	else if (kernel == CullKernel::SSE)
+	{
+		done = n & ~(size_t)3;
+		count = boxesSSE(lo, hi, done, frustum, out, count);
+	}
+#else
+	(void)kernel;
+#endif
+
+	count = boxesScalar(lo, hi, done, n, frustum, out, count);
+	visible.resize(count);
+}
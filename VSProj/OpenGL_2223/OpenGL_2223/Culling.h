@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//six planes (a, b, c, d) facing inwards and normalised, a point p is inside a plane when
+//a*px + b*py + c*pz + d >= 0. order: left, right, bottom, top, near, far
+struct Frustum
+{
+	float planes[6][4];
+};
+
+//gribb/hartmann extraction from a column-major view-projection matrix (gl clip space)
+Frustum makeFrustum(const float* viewProjection);
+
+struct Aabb
+{
+	float min[3];
+	float max[3];
+};
+
+enum class CullKernel
+{
+	Scalar,
+	SSE,	//4 objects per test
+	AVX2	//8 objects per test
+};
+
+//widest kernel this cpu runs (checked once at runtime, scalar off x86)
+CullKernel bestCullKernel();
+const char* cullKernelName(CullKernel kernel);
+
+//bounding volumes for frustum culling, stored as structure of arrays so the kernels
+//load 4/8 objects' worth of one component at a time. each object has a sphere for the
+//cheap test and an aabb for the tight one
+class CullingSet
+{
+public:
+	void reserve(size_t count);
+	void clear();
+
+	uint32_t add(const float center[3], float radius, const float boundsMin[3], const float boundsMax[3]);
+	void setSphere(uint32_t index, const float center[3], float radius);
+	void setBounds(uint32_t index, const float boundsMin[3], const float boundsMax[3]);
+
+	size_t size() const { return radius.size(); }
+
+	//fills visible with the indices of objects that may be in the frustum, ascending
+	void cullSpheres(const Frustum& frustum, std::vector<uint32_t>& visible, CullKernel kernel = bestCullKernel()) const;
+	void cullBoxes(const Frustum& frustum, std::vector<uint32_t>& visible, CullKernel kernel = bestCullKernel()) const;
+
+private:
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+};
@@ -0,0 +1,187 @@
+#include "Entities.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//columns start on a 16 byte boundary so sse loads over a column line up
+static const size_t COLUMN_ALIGNMENT = 16;
+
+static std::atomic<ComponentId> componentCount{ 0 };
+static size_t componentSizes[EntityWorld::MAX_COMPONENTS];
+static size_t componentAlignments[EntityWorld::MAX_COMPONENTS];
+
+ComponentId registerComponent(size_t size, size_t alignment)
+{
+	ComponentId id = componentCount.fetch_add(1);
+	if (id >= EntityWorld::MAX_COMPONENTS)
+	{
+		std::cout << "ERROR MORE THAN " << EntityWorld::MAX_COMPONENTS << " COMPONENT TYPES" << std::endl;
+		std::abort();
+	}
+	componentSizes[id] = size;
+	componentAlignments[id] = alignment;
+	return id;
+}
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t EntityWorld::getChunkCount() const
+{
+	size_t count = 0;
+	for (const Archetype& archetype : archetypes)
+		count += archetype.chunks.size();
+	return count;
+}
+
+uint32_t EntityWorld::findArchetype(ComponentMask mask)
+{
+	auto found = archetypeIndex.find(mask);
+	if (found != archetypeIndex.end())
+		return found->second;
+
+	Archetype archetype;
+	archetype.mask = mask;
+	std::fill(archetype.offsets, archetype.offsets + MAX_COMPONENTS, 0u);
+	size_t rowSize = sizeof(Entity);
+	size_t padding = 0;
+	for (ComponentId id = 0; id < MAX_COMPONENTS; id++)
+	{
+		if (mask & (ComponentMask(1) << id))
+		{
+			archetype.components.push_back(id);
+			rowSize += componentSizes[id];
+			padding += std::max(componentAlignments[id], COLUMN_ALIGNMENT);
+		}
+	}
+
+	//as many rows as fit once every column has been aligned
+	archetype.capacity = (uint32_t)((CHUNK_SIZE - padding) / rowSize);
+	if (archetype.capacity == 0)
+	{
+		std::cout << "ERROR ARCHETYPE ROW OF " << rowSize << " BYTES DOESN'T FIT IN A CHUNK" << std::endl;
+		std::abort();
+	}
+	size_t offset = sizeof(Entity) * archetype.capacity;
+	for (ComponentId id : archetype.components)
+	{
+		offset = alignUp(offset, std::max(componentAlignments[id], COLUMN_ALIGNMENT));
+		archetype.offsets[id] = (uint32_t)offset;
+		offset += componentSizes[id] * archetype.capacity;
+	}
+
+	uint32_t index = (uint32_t)archetypes.size();
+	archetypes.push_back(std::move(archetype));
+	archetypeIndex[mask] = index;
+	return index;
+}
+
+void EntityWorld::insertRow(Entity entity, uint32_t archetypeIndex)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+		archetype.chunks.push_back({ chunkPool.create(), 0 });
+
+	Chunk& chunk = archetype.chunks.back();
+	uint32_t row = chunk.count++;
+	reinterpret_cast<Entity*>(chunk.memory->bytes)[row] = entity;
+	for (ComponentId id : archetype.components)
+		std::memset(chunk.memory->bytes + archetype.offsets[id] + componentSizes[id] * row, 0, componentSizes[id]);
+
+	records[entity] = { archetypeIndex, (uint32_t)archetype.chunks.size() - 1, row };
+}
+
+void EntityWorld::removeRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+	Chunk& last = archetype.chunks.back();
+	uint32_t lastRow = last.count - 1;
+	Chunk& chunk = archetype.chunks[chunkIndex];
+
+	if (&chunk != &last || row != lastRow)
+	{
+		Entity moved = reinterpret_cast<Entity*>(last.memory->bytes)[lastRow];
+		reinterpret_cast<Entity*>(chunk.memory->bytes)[row] = moved;
+		for (ComponentId id : archetype.components)
+		{
+			size_t size = componentSizes[id];
+			std::memcpy(chunk.memory->bytes + archetype.offsets[id] + size * row,
+				last.memory->bytes + archetype.offsets[id] + size * lastRow, size);
+		}
+		records[moved].chunk = chunkIndex;
+		records[moved].row = row;
+	}
+
+	//empty chunks go back to the pool
+	if (--last.count == 0)
+	{
+		chunkPool.destroy(last.memory);
+		archetype.chunks.pop_back();
+	}
+}
+
+Entity EntityWorld::createEntity(ComponentMask mask)
+{
+	Entity entity;
+	if (!freeEntities.empty())
+	{
+		entity = freeEntities.back();
+		freeEntities.pop_back();
+	}
+	else
+	{
+		entity = (Entity)records.size();
+		records.push_back({ NO_ARCHETYPE, 0, 0 });
+	}
+	insertRow(entity, findArchetype(mask));
+	return entity;
+}
+
+void EntityWorld::destroy(Entity entity)
+{
+	EntityRecord record = records[entity];
+	removeRow(record.archetype, record.chunk, record.row);
+	records[entity].archetype = NO_ARCHETYPE;
+	freeEntities.push_back(entity);
+}
+
+void EntityWorld::setMask(Entity entity, ComponentMask mask)
+{
+	EntityRecord from = records[entity];
+	if (archetypes[from.archetype].mask == mask)
+		return;
+
+	//findArchetype can grow the array, look the old one up again afterwards
+	uint32_t toIndex = findArchetype(mask);
+	insertRow(entity, toIndex);
+	const Archetype& source = archetypes[from.archetype];
+	const Archetype& target = archetypes[toIndex];
+	const unsigned char* sourceBytes = source.chunks[from.chunk].memory->bytes;
+	const EntityRecord& to = records[entity];
+	unsigned char* targetBytes = target.chunks[to.chunk].memory->bytes;
+
+	//components both archetypes have come along, the new one stays zeroed
+	for (ComponentId id : target.components)
+	{
+		if (source.mask & (ComponentMask(1) << id))
+		{
+			size_t size = componentSizes[id];
+			std::memcpy(targetBytes + target.offsets[id] + size * to.row, sourceBytes + source.offsets[id] + size * from.row, size);
+		}
+	}
+	removeRow(from.archetype, from.chunk, from.row);
+}
+
+void EntityWorld::gatherChunks(ComponentMask mask)
+{
+	queryChunks.clear();
+	for (uint32_t a = 0; a < (uint32_t)archetypes.size(); a++)
+		if ((archetypes[a].mask & mask) == mask)
+			for (uint32_t c = 0; c < (uint32_t)archetypes[a].chunks.size(); c++)
+				queryChunks.push_back({ a, c });
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Memory.h"
+
+typedef uint32_t Entity;
+typedef uint32_t ComponentId;
+//bit per component id
+typedef uint64_t ComponentMask;
+
+//components are plain data, moved between chunks with memcpy
+ComponentId registerComponent(size_t size, size_t alignment);
+
+template <typename T>
+ComponentId componentId()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+	static const ComponentId id = registerComponent(sizeof(T), alignof(T));
+	return id;
+}
+
+template <typename... Ts>
+ComponentMask componentMask()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>()));
+}
+
+//entities grouped by archetype (their exact set of components). an archetype stores its
+//entities in 16kb chunks, one column per component, so a query walks a few contiguous
+//arrays per chunk instead of hopping between objects. destroying an entity moves the last
+//one of its archetype into the hole, chunks stay packed.
+//adding/removing components and destroying entities isn't allowed while iterating
+class EntityWorld
+{
+public:
+	template <typename... Ts>
+	Entity create(const Ts&... components)
+	{
+		Entity entity = createEntity(componentMask<Ts...>());
+		((*get<Ts>(entity) = components), ...);
+		return entity;
+	}
+	void destroy(Entity entity);
+
+	//moves the entity to the archetype with or without the component
+	template <typename T>
+	void add(Entity entity, const T& component)
+	{
+		setMask(entity, getMask(entity) | componentMask<T>());
+		*get<T>(entity) = component;
+	}
+	template <typename T>
+	void remove(Entity entity)
+	{
+		setMask(entity, getMask(entity) & ~componentMask<T>());
+	}
+
+	template <typename T>
+	bool has(Entity entity) const { return (getMask(entity) & componentMask<T>()) != 0; }
+	//null when the entity doesn't have one, valid until the next structural change
+	template <typename T>
+	T* get(Entity entity)
+	{
+		const EntityRecord& record = records[entity];
+		Archetype& archetype = archetypes[record.archetype];
+		if (!(archetype.mask & componentMask<T>()))
+			return nullptr;
+		return column<T>(archetype, archetype.chunks[record.chunk]) + record.row;
+	}
+
+	//f(count, Ts*...) once per chunk of every archetype that has all of Ts
+	template <typename... Ts, typename F>
+	void forEachChunk(F&& f)
+	{
+		ComponentMask mask = componentMask<Ts...>();
+		for (Archetype& archetype : archetypes)
+			if ((archetype.mask & mask) == mask)
+				for (Chunk& chunk : archetype.chunks)
+					f(chunk.count, column<Ts>(archetype, chunk)...);
+	}
+	//same, chunks spread over the job system's workers
+	template <typename... Ts, typename F>
+	void forEachChunk(JobSystem& jobs, F&& f)
+	{
+		gatherChunks(componentMask<Ts...>());
+		jobs.parallelFor((uint32_t)queryChunks.size(), 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				Archetype& archetype = archetypes[queryChunks[i].archetype];
+				Chunk& chunk = archetype.chunks[queryChunks[i].chunk];
+				f(chunk.count, column<Ts>(archetype, chunk)...);
+			}
+		});
+	}
+
+	//f(Ts&...) for every entity that has all of Ts
+	template <typename... Ts, typename F>
+	void each(F&& f)
+	{
+		forEachChunk<Ts...>([&](uint32_t count, Ts*... columns)
+		{
+			for (uint32_t i = 0; i < count; i++)
+				f(columns[i]...);
+		});
+	}
+	template <typename... Ts, typename F>
+	void each(JobSystem& jobs, F&& f)
+	{
+		forEachChunk<Ts...>(jobs, [&](uint32_t count, Ts*... columns)
+		{
+			for (uint32_t i = 0; i < count; i++)
+				f(columns[i]...);
+		});
+	}
+
+	size_t size() const { return records.size() - freeEntities.size(); }
+	size_t getArchetypeCount() const { return archetypes.size(); }
+	size_t getChunkCount() const;
+
+	static constexpr size_t CHUNK_SIZE = 16 * 1024;
+	static constexpr int MAX_COMPONENTS = 64;
+	static constexpr uint32_t NO_ARCHETYPE = 0xFFFFFFFF;
+
+private:
+	struct alignas(64) ChunkMemory
+	{
+		unsigned char bytes[CHUNK_SIZE];
+	};
+
+	struct Chunk
+	{
+		ChunkMemory* memory;
+		uint32_t count;
+	};
+
+	struct Archetype
+	{
+		ComponentMask mask;
+		std::vector<ComponentId> components;
+		uint32_t offsets[MAX_COMPONENTS];	//column start in the chunk per component id, entity ids are at 0
+		uint32_t capacity;					//entities per chunk
+		std::vector<Chunk> chunks;			//every chunk but the last is full
+	};
+
+	struct EntityRecord
+	{
+		uint32_t archetype;		//NO_ARCHETYPE while the id is free
+		uint32_t chunk;
+		uint32_t row;
+	};
+
+	struct QueryChunk
+	{
+		uint32_t archetype, chunk;
+	};
+
+	template <typename T>
+	static T* column(const Archetype& archetype, const Chunk& chunk)
+	{
+		return reinterpret_cast<T*>(chunk.memory->bytes + archetype.offsets[componentId<T>()]);
+	}
+
+	Entity createEntity(ComponentMask mask);
+	ComponentMask getMask(Entity entity) const { return archetypes[records[entity].archetype].mask; }
+	void setMask(Entity entity, ComponentMask mask);
+	uint32_t findArchetype(ComponentMask mask);
+	//appends a zeroed row to the archetype's last chunk
+	void insertRow(Entity entity, uint32_t archetype);
+	//fills the hole with the archetype's last entity
+	void removeRow(uint32_t archetype, uint32_t chunk, uint32_t row);
+	void gatherChunks(ComponentMask mask);
+
+	std::vector<Archetype> archetypes;
+	std::unordered_map<ComponentMask, uint32_t> archetypeIndex;
+	std::vector<EntityRecord> records;
+	std::vector<Entity> freeEntities;
+	ObjectPool<ChunkMemory, 16> chunkPool;
+	std::vector<QueryChunk> queryChunks;
+};
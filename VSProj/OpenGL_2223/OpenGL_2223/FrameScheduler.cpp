@@ -0,0 +1,98 @@
+#include "FrameScheduler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+static const char* STAGE_NAMES[STAGE_COUNT] = { "update", "render", "present", "idle" };
+
+void FrameScheduler::init(const FrameSchedulerSettings& frameSettings)
+{
+	settings = frameSettings;
+	frequency = glfwGetTimerFrequency();
+	frameStart = lastFrameStart = glfwGetTimerValue();
+	accumulator = 0.0;
+	frameIndex = 0;
+	droppedSteps = 0;
+}
+
+void FrameScheduler::beginFrame()
+{
+	lastFrameStart = frameStart;
+	frameStart = glfwGetTimerValue();
+	deltaTime = seconds(frameStart - lastFrameStart);
+
+	accumulator += deltaTime;
+	stepsThisFrame = 0;
+	frameIndex++;
+
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+		stageMs[stage] = 0.0;
+}
+
+bool FrameScheduler::step()
+{
+	if (accumulator < settings.fixedStep)
+		return false;
+
+	//a slow frame would need even more updates next frame (spiral of death),
+	//drop whole steps past the cap and keep the remainder for interpolation
+	if (stepsThisFrame >= settings.maxCatchUpSteps)
+	{
+		while (accumulator >= settings.fixedStep)
+		{
+			accumulator -= settings.fixedStep;
+			droppedSteps++;
+		}
+		return false;
+	}
+
+	accumulator -= settings.fixedStep;
+	stepsThisFrame++;
+	return true;
+}
+
+void FrameScheduler::endFrame()
+{
+	if (settings.targetFrameTime <= 0.0)
+		return;
+
+	beginStage(STAGE_IDLE);
+
+	uint64_t target = frameStart + (uint64_t)(settings.targetFrameTime * frequency);
+	uint64_t now = glfwGetTimerValue();
+
+	//sleep is coarse (up to a scheduler tick late), so stop short and spin the rest
+	double remaining = now < target ? seconds(target - now) : 0.0;
+	if (remaining > settings.spinTime)
+		std::this_thread::sleep_for(std::chrono::duration<double>(remaining - settings.spinTime));
+
+	while (glfwGetTimerValue() < target)
+		std::this_thread::yield();
+
+	endStage(STAGE_IDLE);
+}
+
+void FrameScheduler::beginStage(FrameStage stage)
+{
+	stageStart[stage] = glfwGetTimerValue();
+}
+
+void FrameScheduler::endStage(FrameStage stage)
+{
+	double ms = seconds(glfwGetTimerValue() - stageStart[stage]) * 1000.0;
+	stageMs[stage] += ms;
+	stageTotalMs[stage] += ms;
+}
+
+void FrameScheduler::report() const
+{
+	if (frameIndex == 0)
+		return;
+
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+		std::printf("%-10s avg %8.3f ms\n", STAGE_NAMES[stage], stageTotalMs[stage] / frameIndex);
+	std::printf("dropped %u fixed steps\n", droppedSteps);
+}
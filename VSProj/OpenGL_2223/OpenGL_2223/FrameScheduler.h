@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+
+enum FrameStage
+{
+	STAGE_UPDATE,
+	STAGE_RENDER,
+	STAGE_PRESENT,
+	STAGE_IDLE,	//time spent in the frame limiter
+	STAGE_COUNT
+};
+
+struct FrameSchedulerSettings
+{
+	double fixedStep = 1.0 / 60.0;		//seconds per simulation update
+	int maxCatchUpSteps = 5;			//updates per frame before dropping time
+	double targetFrameTime = 0.0;		//seconds, 0 disables the limiter
+	double spinTime = 0.002;			//sleep until this close to the target, then spin
+};
+
+//fixed timestep simulation with render interpolation and an optional frame limiter.
+//
+//	scheduler.beginFrame();
+//	while (scheduler.step()) update(scheduler.getFixedStep());
+//	render(scheduler.getAlpha());
+//	scheduler.endFrame();
+class FrameScheduler
+{
+public:
+	//glfw needs to be initialised for the timer
+	void init(const FrameSchedulerSettings& settings = FrameSchedulerSettings());
+
+	void beginFrame();
+	//true while another fixed update is due this frame
+	bool step();
+	//sleeps/spins to the target frame time if there is one
+	void endFrame();
+
+	//how far between the last two updates to render, 0-1
+	double getAlpha() const { return accumulator / settings.fixedStep; }
+	double getFixedStep() const { return settings.fixedStep; }
+	double getDeltaTime() const { return deltaTime; }
+	uint64_t getFrameIndex() const { return frameIndex; }
+	unsigned getDroppedSteps() const { return droppedSteps; }
+
+	void beginStage(FrameStage stage);
+	void endStage(FrameStage stage);
+	//last frame's time in a stage, milliseconds
+	double getStageMs(FrameStage stage) const { return stageMs[stage]; }
+
+	//average ms per stage over every frame so far
+	void report() const;
+
+private:
+	double seconds(uint64_t ticks) const { return (double)ticks / (double)frequency; }
+
+	FrameSchedulerSettings settings;
+	uint64_t frequency = 1;
+	uint64_t frameStart = 0;
+	uint64_t lastFrameStart = 0;
+	double deltaTime = 0.0;
+	double accumulator = 0.0;
+	int stepsThisFrame = 0;
+	uint64_t frameIndex = 0;
+	unsigned droppedSteps = 0;
+
+	uint64_t stageStart[STAGE_COUNT] = {};
+	double stageMs[STAGE_COUNT] = {};
+	double stageTotalMs[STAGE_COUNT] = {};
+};
@@ -0,0 +1,31 @@
+#include "GLExtensions.h"
+
+#include <GLFW/glfw3.h>
+
+GLExtensions glExt;
+
+static bool hasVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+void loadExtensions()
+{
+	if (hasVersion(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary"))
+	{
+		glExt.getProgramBinary = (PFNEXTGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+		glExt.programBinaryLoad = (PFNEXTPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+		glExt.programParameteri = (PFNEXTPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+		glExt.programBinary = glExt.getProgramBinary && glExt.programBinaryLoad && glExt.programParameteri;
+	}
+
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+		glExt.maxShaderCompilerThreads = (PFNEXTMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+		glExt.maxShaderCompilerThreads = (PFNEXTMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	glExt.parallelShaderCompile = glExt.maxShaderCompilerThreads != nullptr;
+
+	if (hasVersion(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+		glExt.bufferStorageAlloc = (PFNEXTBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+	glExt.bufferStorage = glExt.bufferStorageAlloc != nullptr;
+}
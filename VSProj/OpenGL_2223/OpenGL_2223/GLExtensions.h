@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+
+//glad is generated for plain gl 3.3, newer entry points are loaded here by hand
+
+//ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+//KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+//ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (APIENTRYP PFNEXTGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNEXTPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNEXTPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNEXTMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+typedef void (APIENTRYP PFNEXTBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct GLExtensions
+{
+	bool programBinary = false;
+	PFNEXTGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+	PFNEXTPROGRAMBINARYPROC programBinaryLoad = nullptr;
+	PFNEXTPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+	bool parallelShaderCompile = false;
+	PFNEXTMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+
+	bool bufferStorage = false;
+	PFNEXTBUFFERSTORAGEPROC bufferStorageAlloc = nullptr;
+};
+
+extern GLExtensions glExt;
+
+//call once after gladLoadGLLoader with the context current
+void loadExtensions();
@@ -0,0 +1,376 @@
+#include "GLStateCache.h"
+
+#include <cstring>
+
+//shadowed value that hasn't been seen yet, forces the next call through
+static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+static const GLenum BUFFER_TARGETS[] =
+{
+	GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER,
+	GL_COPY_WRITE_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_BUFFER,
+	GL_TRANSFORM_FEEDBACK_BUFFER
+};
+static const int BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]);
+static const int ELEMENT_BUFFER_SLOT = 1;
+
+static const GLenum TEXTURE_TARGETS[] =
+{
+	GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER
+};
+static const int TEXTURE_TARGET_COUNT = sizeof(TEXTURE_TARGETS) / sizeof(TEXTURE_TARGETS[0]);
+static const int TEXTURE_UNITS = 32;
+
+static const GLenum CAPS[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST };
+static const int CAP_COUNT = sizeof(CAPS) / sizeof(CAPS[0]);
+
+struct ShadowState
+{
+	GLuint program;
+	GLuint vao;
+	GLuint buffers[BUFFER_TARGET_COUNT];
+	GLuint activeTexture;	//index, not GL_TEXTUREi
+	GLuint textures[TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	int caps[CAP_COUNT];	//-1 unknown
+	GLenum blend[4];		//src rgb, dst rgb, src alpha, dst alpha
+	GLenum depthFunc;
+	int depthMask;
+	GLint viewport[4];
+};
+
+//the driver entry points the wrappers forward to
+struct DriverFunctions
+{
+	PFNGLUSEPROGRAMPROC useProgram;
+	PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+	PFNGLBINDBUFFERPROC bindBuffer;
+	PFNGLBINDBUFFERBASEPROC bindBufferBase;
+	PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+	PFNGLACTIVETEXTUREPROC activeTexture;
+	PFNGLBINDTEXTUREPROC bindTexture;
+	PFNGLENABLEPROC enable;
+	PFNGLDISABLEPROC disable;
+	PFNGLBLENDFUNCPROC blendFunc;
+	PFNGLBLENDFUNCSEPARATEPROC blendFuncSeparate;
+	PFNGLDEPTHFUNCPROC depthFunc;
+	PFNGLDEPTHMASKPROC depthMask;
+	PFNGLVIEWPORTPROC viewport;
+	PFNGLDELETEPROGRAMPROC deleteProgram;
+	PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+	PFNGLDELETEBUFFERSPROC deleteBuffers;
+	PFNGLDELETETEXTURESPROC deleteTextures;
+};
+
+static ShadowState state;
+static DriverFunctions driver;
+static GLStateCacheStats stats;
+static bool installed = false;
+
+static int bufferSlot(GLenum target)
+{
+	for (int i = 0; i < BUFFER_TARGET_COUNT; i++)
+		if (BUFFER_TARGETS[i] == target) return i;
+	return -1;
+}
+
+static int textureSlot(GLenum target)
+{
+	for (int i = 0; i < TEXTURE_TARGET_COUNT; i++)
+		if (TEXTURE_TARGETS[i] == target) return i;
+	return -1;
+}
+
+static int capSlot(GLenum cap)
+{
+	for (int i = 0; i < CAP_COUNT; i++)
+		if (CAPS[i] == cap) return i;
+	return -1;
+}
+
+//true when the call can be dropped, counts either way
+static bool same(bool unchanged)
+{
+	if (unchanged) stats.hits++;
+	else stats.misses++;
+	return unchanged;
+}
+
+static void APIENTRY cachedUseProgram(GLuint program)
+{
+	if (same(state.program == program)) return;
+	state.program = program;
+	driver.useProgram(program);
+}
+
+static void APIENTRY cachedBindVertexArray(GLuint vao)
+{
+	if (same(state.vao == vao)) return;
+	state.vao = vao;
+	//the element buffer binding is vao state, whatever this vao had is now bound
+	state.buffers[ELEMENT_BUFFER_SLOT] = UNKNOWN;
+	driver.bindVertexArray(vao);
+}
+
+static void APIENTRY cachedBindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = bufferSlot(target);
+	if (slot >= 0)
+	{
+		if (same(state.buffers[slot] == buffer)) return;
+		state.buffers[slot] = buffer;
+	}
+	driver.bindBuffer(target, buffer);
+}
+
+//indexed binds also set the generic binding point, never skipped (the range may differ)
+static void APIENTRY cachedBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	int slot = bufferSlot(target);
+	if (slot >= 0) state.buffers[slot] = buffer;
+	stats.misses++;
+	driver.bindBufferBase(target, index, buffer);
+}
+
+static void APIENTRY cachedBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	int slot = bufferSlot(target);
+	if (slot >= 0) state.buffers[slot] = buffer;
+	stats.misses++;
+	driver.bindBufferRange(target, index, buffer, offset, size);
+}
+
+static void APIENTRY cachedActiveTexture(GLenum texture)
+{
+	GLuint unit = texture - GL_TEXTURE0;
+	if (same(state.activeTexture == unit)) return;
+	state.activeTexture = unit;
+	driver.activeTexture(texture);
+}
+
+static void APIENTRY cachedBindTexture(GLenum target, GLuint texture)
+{
+	int slot = textureSlot(target);
+	GLuint unit = state.activeTexture;
+	if (slot >= 0 && unit < TEXTURE_UNITS)
+	{
+		if (same(state.textures[unit][slot] == texture)) return;
+		state.textures[unit][slot] = texture;
+	}
+	driver.bindTexture(target, texture);
+}
+
+static void APIENTRY cachedEnable(GLenum cap)
+{
+	int slot = capSlot(cap);
+	if (slot >= 0)
+	{
+		if (same(state.caps[slot] == 1)) return;
+		state.caps[slot] = 1;
+	}
+	driver.enable(cap);
+}
+
+static void APIENTRY cachedDisable(GLenum cap)
+{
+	int slot = capSlot(cap);
+	if (slot >= 0)
+	{
+		if (same(state.caps[slot] == 0)) return;
+		state.caps[slot] = 0;
+	}
+	driver.disable(cap);
+}
+
+static void APIENTRY cachedBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+{
+	GLenum blend[4] = { srcRGB, dstRGB, srcAlpha, dstAlpha };
+	if (same(std::memcmp(state.blend, blend, sizeof(blend)) == 0)) return;
+	std::memcpy(state.blend, blend, sizeof(blend));
+	driver.blendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+static void APIENTRY cachedBlendFunc(GLenum src, GLenum dst)
+{
+	cachedBlendFuncSeparate(src, dst, src, dst);
+}
+
+static void APIENTRY cachedDepthFunc(GLenum func)
+{
+	if (same(state.depthFunc == func)) return;
+	state.depthFunc = func;
+	driver.depthFunc(func);
+}
+
+static void APIENTRY cachedDepthMask(GLboolean flag)
+{
+	if (same(state.depthMask == (flag ? 1 : 0))) return;
+	state.depthMask = flag ? 1 : 0;
+	driver.depthMask(flag);
+}
+
+static void APIENTRY cachedViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint viewport[4] = { x, y, width, height };
+	if (same(std::memcmp(state.viewport, viewport, sizeof(viewport)) == 0)) return;
+	std::memcpy(state.viewport, viewport, sizeof(viewport));
+	driver.viewport(x, y, width, height);
+}
+
+//a current program is only flagged for deletion and stays in use until another one is,
+//so glUseProgram(0) still has to reach the driver afterwards
+static void APIENTRY cachedDeleteProgram(GLuint program)
+{
+	if (program != 0 && program == state.program)
+		state.program = UNKNOWN;
+	driver.deleteProgram(program);
+}
+
+//deleting a bound object unbinds it, the name can then come back from glGen*
+static void APIENTRY cachedDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (arrays[i] != 0 && arrays[i] == state.vao)
+		{
+			state.vao = 0;
+			state.buffers[ELEMENT_BUFFER_SLOT] = UNKNOWN;
+		}
+	}
+	driver.deleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY cachedDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (buffers[i] == 0) continue;
+		for (int slot = 0; slot < BUFFER_TARGET_COUNT; slot++)
+			if (state.buffers[slot] == buffers[i]) state.buffers[slot] = 0;
+		//may also be the element buffer of a vao that isn't bound, that one we never shadow
+	}
+	driver.deleteBuffers(n, buffers);
+}
+
+static void APIENTRY cachedDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (textures[i] == 0) continue;
+		for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+			for (int slot = 0; slot < TEXTURE_TARGET_COUNT; slot++)
+				if (state.textures[unit][slot] == textures[i]) state.textures[unit][slot] = 0;
+	}
+	driver.deleteTextures(n, textures);
+}
+
+void invalidateStateCache()
+{
+	state.program = UNKNOWN;
+	state.vao = UNKNOWN;
+	for (int slot = 0; slot < BUFFER_TARGET_COUNT; slot++)
+		state.buffers[slot] = UNKNOWN;
+	state.activeTexture = UNKNOWN;
+	for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+		for (int slot = 0; slot < TEXTURE_TARGET_COUNT; slot++)
+			state.textures[unit][slot] = UNKNOWN;
+	for (int slot = 0; slot < CAP_COUNT; slot++)
+		state.caps[slot] = -1;
+	for (int i = 0; i < 4; i++)
+		state.blend[i] = UNKNOWN;
+	state.depthFunc = UNKNOWN;
+	state.depthMask = -1;
+	//no valid viewport has a negative size
+	state.viewport[0] = state.viewport[1] = 0;
+	state.viewport[2] = state.viewport[3] = -1;
+}
+
+void installStateCache()
+{
+	if (installed)
+		return;
+
+	driver.useProgram = glad_glUseProgram;
+	driver.bindVertexArray = glad_glBindVertexArray;
+	driver.bindBuffer = glad_glBindBuffer;
+	driver.bindBufferBase = glad_glBindBufferBase;
+	driver.bindBufferRange = glad_glBindBufferRange;
+	driver.activeTexture = glad_glActiveTexture;
+	driver.bindTexture = glad_glBindTexture;
+	driver.enable = glad_glEnable;
+	driver.disable = glad_glDisable;
+	driver.blendFunc = glad_glBlendFunc;
+	driver.blendFuncSeparate = glad_glBlendFuncSeparate;
+	driver.depthFunc = glad_glDepthFunc;
+	driver.depthMask = glad_glDepthMask;
+	driver.viewport = glad_glViewport;
+	driver.deleteProgram = glad_glDeleteProgram;
+	driver.deleteVertexArrays = glad_glDeleteVertexArrays;
+	driver.deleteBuffers = glad_glDeleteBuffers;
+	driver.deleteTextures = glad_glDeleteTextures;
+
+	//start from unknown rather than gl defaults, something may have run before us
+	invalidateStateCache();
+
+	glad_glUseProgram = cachedUseProgram;
+	glad_glBindVertexArray = cachedBindVertexArray;
+	glad_glBindBuffer = cachedBindBuffer;
+	glad_glBindBufferBase = cachedBindBufferBase;
+	glad_glBindBufferRange = cachedBindBufferRange;
+	glad_glActiveTexture = cachedActiveTexture;
+	glad_glBindTexture = cachedBindTexture;
+	glad_glEnable = cachedEnable;
+	glad_glDisable = cachedDisable;
+	glad_glBlendFunc = cachedBlendFunc;
+	glad_glBlendFuncSeparate = cachedBlendFuncSeparate;
+	glad_glDepthFunc = cachedDepthFunc;
+	glad_glDepthMask = cachedDepthMask;
+	glad_glViewport = cachedViewport;
+	glad_glDeleteProgram = cachedDeleteProgram;
+	glad_glDeleteVertexArrays = cachedDeleteVertexArrays;
+	glad_glDeleteBuffers = cachedDeleteBuffers;
+	glad_glDeleteTextures = cachedDeleteTextures;
+
+	installed = true;
+}
+
+void uninstallStateCache()
+{
+	if (!installed)
+		return;
+
+	glad_glUseProgram = driver.useProgram;
+	glad_glBindVertexArray = driver.bindVertexArray;
+	glad_glBindBuffer = driver.bindBuffer;
+	glad_glBindBufferBase = driver.bindBufferBase;
+	glad_glBindBufferRange = driver.bindBufferRange;
+	glad_glActiveTexture = driver.activeTexture;
+	glad_glBindTexture = driver.bindTexture;
+	glad_glEnable = driver.enable;
+	glad_glDisable = driver.disable;
+	glad_glBlendFunc = driver.blendFunc;
+	glad_glBlendFuncSeparate = driver.blendFuncSeparate;
+	glad_glDepthFunc = driver.depthFunc;
+	glad_glDepthMask = driver.depthMask;
+	glad_glViewport = driver.viewport;
+	glad_glDeleteProgram = driver.deleteProgram;
+	glad_glDeleteVertexArrays = driver.deleteVertexArrays;
+	glad_glDeleteBuffers = driver.deleteBuffers;
+	glad_glDeleteTextures = driver.deleteTextures;
+
+	installed = false;
+}
+
+bool isStateCacheInstalled()
+{
+	return installed;
+}
+
+const GLStateCacheStats& getStateCacheStats()
+{
+	return stats;
+}
+
+void resetStateCacheStats()
+{
+	stats = GLStateCacheStats();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+#include <glad/glad.h>
+
+//shadow copy of the gl binding/fixed function state that sits in front of the driver.
+//installing swaps the glad function pointers (glad_glUseProgram etc.) for wrappers that
+//drop calls setting state to what it already is, so the rest of the code keeps calling
+//plain glUseProgram/glBindBuffer and gets the filtering for free.
+//
+//tracked: program, vao, buffer bindings, active texture + per unit textures, enable
+//caps (blend, depth, cull, scissor, stencil), blend func, depth func/mask, viewport.
+//deletes (programs, vaos, buffers, textures) are wrapped too so reused names can't hit stale entries.
+//the cache belongs to one context, only call gl from the thread that owns it.
+
+struct GLStateCacheStats
+{
+	uint64_t hits = 0;		//calls dropped because nothing changed
+	uint64_t misses = 0;	//calls forwarded to the driver
+};
+
+//call once after gladLoadGLLoader (and loadExtensions) with the context current
+void installStateCache();
+//puts the original glad pointers back
+void uninstallStateCache();
+bool isStateCacheInstalled();
+
+//forget everything, needed after gl calls that went around the cache
+//(another loader, a library holding its own function pointers, a context switch)
+void invalidateStateCache();
+
+const GLStateCacheStats& getStateCacheStats();
+void resetStateCacheStats();
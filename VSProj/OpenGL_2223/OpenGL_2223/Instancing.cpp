@@ -0,0 +1,74 @@
+#include "Instancing.h"
+
+static const GLsizeiptr TRANSFORM_SIZE = 16 * sizeof(float);
+static const GLsizeiptr COLOUR_SIZE = 4 * sizeof(float);
+
+void InstanceBatch::init(GLuint meshVAO, GLenum drawMode, GLsizei drawCount, GLenum drawIndexType)
+{
+	vao = meshVAO;
+	mode = drawMode;
+	count = drawCount;
+	indexType = drawIndexType;
+
+	glGenBuffers(1, &instanceVBO);
+}
+
+void InstanceBatch::destroy()
+{
+	glDeleteBuffers(1, &instanceVBO);
+	instanceVBO = 0;
+	instances = capacity = 0;
+}
+
+void InstanceBatch::upload(const float* transforms, const float* colours, GLsizei instanceCount)
+{
+	instances = instanceCount;
+	GLsizeiptr transformBytes = TRANSFORM_SIZE * instanceCount;
+	GLsizeiptr colourBytes = COLOUR_SIZE * instanceCount;
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	//orphan on every upload, the attribute layout only changes when the buffer grows
+	bool grew = instanceCount > capacity;
+	if (grew) capacity = instanceCount;
+	glBufferData(GL_ARRAY_BUFFER, (TRANSFORM_SIZE + COLOUR_SIZE) * capacity, nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, transformBytes, transforms);
+	glBufferSubData(GL_ARRAY_BUFFER, TRANSFORM_SIZE * capacity, colourBytes, colours);
+
+	if (grew)
+	{
+		//a mat4 attribute is four vec4 columns
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = INSTANCE_TRANSFORM_LOCATION + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, (GLsizei)TRANSFORM_SIZE, (void*)(column * 4 * sizeof(float)));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+
+		glVertexAttribPointer(INSTANCE_COLOUR_LOCATION, 4, GL_FLOAT, GL_FALSE, (GLsizei)COLOUR_SIZE, (void*)(TRANSFORM_SIZE * capacity));
+		glEnableVertexAttribArray(INSTANCE_COLOUR_LOCATION);
+		glVertexAttribDivisor(INSTANCE_COLOUR_LOCATION, 1);
+	}
+}
+
+void InstanceBatch::draw() const
+{
+	if (instances == 0)
+		return;
+
+	glBindVertexArray(vao);
+	if (indexType)
+		glDrawElementsInstanced(mode, count, indexType, nullptr, instances);
+	else
+		glDrawArraysInstanced(mode, 0, count, instances);
+}
+
+DrawPacket InstanceBatch::makePacket(GLuint program, GLuint material, float depth) const
+{
+	DrawPacket packet = { program, vao, material, depth, mode, 0, count };
+	packet.indexType = indexType;
+	packet.instances = instances;
+	return packet;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+
+//attribute locations used by Shaders/instancedVertex.shader
+const GLuint INSTANCE_TRANSFORM_LOCATION = 1;	//mat4, takes locations 1-4
+const GLuint INSTANCE_COLOUR_LOCATION = 5;
+
+//draws many copies of one mesh with a single instanced draw call.
+//per-instance data is kept as two arrays (structure of arrays): column-major
+//mat4 transforms and rgba colours, uploaded back to back into one buffer
+class InstanceBatch
+{
+public:
+	//adds the instance attributes to the mesh's vao, indexType 0 means glDrawArrays
+	void init(GLuint meshVAO, GLenum mode, GLsizei count, GLenum indexType = 0);
+	void destroy();
+
+	//transforms holds 16 floats per instance, colours 4
+	void upload(const float* transforms, const float* colours, GLsizei instanceCount);
+
+	void draw() const;
+	DrawPacket makePacket(GLuint program, GLuint material = 0, float depth = 0.0f) const;
+
+	GLsizei getInstanceCount() const { return instances; }
+
+private:
+	GLuint vao = 0;
+	GLuint instanceVBO = 0;
+	GLenum mode = GL_TRIANGLES;
+	GLsizei count = 0;
+	GLenum indexType = 0;
+	GLsizei instances = 0;
+	GLsizei capacity = 0;
+};
@@ -0,0 +1,281 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+//idle workers yield this many times before going to sleep
+static const int SPIN_COUNT = 64;
+//parallel_for keeps splitting while its deque has fewer jobs than this
+static const int64_t SPLIT_QUEUE_SIZE = 2;
+
+static thread_local int threadIndex = -1;
+
+bool WorkStealingDeque::push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY)
+		return false;
+
+	buffer[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* WorkStealingDeque::pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		//was empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = buffer[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		//last one, race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+
+	Job* job = buffer[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+void JobSystem::init(int threads)
+{
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 0; i < threads; i++)
+	{
+		workers.push_back(std::make_unique<Worker>());
+		workers.back()->random = 0x9E3779B9u * (i + 1);
+	}
+
+	running = true;
+	threadIndex = 0;
+	for (int i = 1; i < threads; i++)
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::shutdown()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (std::unique_ptr<Worker>& worker : workers)
+		if (worker->thread.joinable()) worker->thread.join();
+	workers.clear();
+	threadIndex = -1;
+}
+
+int JobSystem::getThreadIndex()
+{
+	return threadIndex;
+}
+
+void JobSystem::run(JobFunction function, void* data, uint32_t begin, uint32_t end, JobCounter* counter, const JobCounter* after)
+{
+	int index = threadIndex;
+	if (index < 0 || index >= (int)workers.size())
+	{
+		//not one of ours, there's no deque to put it on
+		if (after)
+			wait(*after);
+		function(data, begin, end);
+		return;
+	}
+
+	Worker& worker = *workers[index];
+	uint32_t slot = worker.nextJob++ & (JOB_POOL_SIZE - 1);
+	std::atomic<bool>& busy = worker.busy[slot];
+
+	//the slot's last job can still be running on a thief or parked on some worker
+	while (busy.load(std::memory_order_acquire) && executeOne(index))
+	{
+	}
+	if (busy.load(std::memory_order_acquire))
+	{
+		//nothing left to help with, do this one here rather than wait on the other thread
+		if (after)
+			wait(*after);
+		function(data, begin, end);
+		return;
+	}
+
+	Job* job = &worker.jobs[slot];
+	*job = { function, data, begin, end, counter, after, &busy };
+	busy.store(true, std::memory_order_relaxed);
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	while (!worker.deque.push(job))
+	{
+		//full, make room by doing some of the work ourselves
+		executeOne(index);
+	}
+
+	if (sleeping.load(std::memory_order_relaxed) > 0)
+		wake.notify_one();
+}
+
+bool JobSystem::executeOne(int index)
+{
+	Worker& worker = *workers[index];
+
+	//jobs whose dependency has finished since they were parked
+	Job* job = nullptr;
+	for (size_t i = 0; i < worker.parked.size() && !job; i++)
+	{
+		if (worker.parked[i]->after->done())
+		{
+			job = worker.parked[i];
+			worker.parked[i] = worker.parked.back();
+			worker.parked.pop_back();
+		}
+	}
+
+	if (!job)
+		job = worker.deque.pop();
+	if (!job)
+	{
+		//start at a random victim so thieves spread out
+		int count = (int)workers.size();
+		worker.random ^= worker.random << 13;
+		worker.random ^= worker.random >> 17;
+		worker.random ^= worker.random << 5;
+		int start = (int)(worker.random % (uint32_t)count);
+		for (int i = 0; i < count && !job; i++)
+		{
+			int victim = (start + i) % count;
+			if (victim != index)
+				job = workers[victim]->deque.steal();
+		}
+		if (!job)
+			return false;
+		stats.stolen.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (job->after && !job->after->done())
+	{
+		//dependency isn't finished, set it aside so the work it waits for can run first
+		worker.parked.push_back(job);
+		return true;
+	}
+
+	job->function(job->data, job->begin, job->end);
+	if (job->counter)
+		job->counter->pending.fetch_sub(1, std::memory_order_release);
+	//last touch, the owner may reuse the slot after this
+	job->busy->store(false, std::memory_order_release);
+	stats.executed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+	int index = threadIndex;
+	while (!counter.done())
+	{
+		if (index < 0 || index >= (int)workers.size() || !executeOne(index))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop(int index)
+{
+	threadIndex = index;
+	int idle = 0;
+	while (running.load(std::memory_order_relaxed))
+	{
+		if (executeOne(index))
+		{
+			idle = 0;
+			continue;
+		}
+		if (++idle < SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		//the timeout covers a job pushed between the last steal attempt and the wait
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping++;
+		if (running)
+			wake.wait_for(lock, std::chrono::milliseconds(1));
+		sleeping--;
+		idle = 0;
+	}
+}
+
+bool JobSystem::wantsSplit() const
+{
+	int index = threadIndex;
+	return workers.size() > 1 && index >= 0 && index < (int)workers.size()
+		&& workers[index]->deque.size() < SPLIT_QUEUE_SIZE;
+}
+
+//one parallel_for call, lives on the caller's stack until every chunk is done
+struct JobSystem::ParallelFor
+{
+	JobSystem* system;
+	JobFunction function;
+	void* data;
+	uint32_t minChunk;
+	JobCounter counter;
+};
+
+void JobSystem::splitJob(void* data, uint32_t begin, uint32_t end)
+{
+	//hand the upper half to whoever steals it and keep going with the lower half
+	ParallelFor& loop = *(ParallelFor*)data;
+	while (end - begin > loop.minChunk && loop.system->wantsSplit())
+	{
+		uint32_t middle = begin + (end - begin) / 2;
+		loop.system->run(splitJob, data, middle, end, &loop.counter);
+		end = middle;
+	}
+	loop.function(loop.data, begin, end);
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t minChunk, JobFunction function, void* data)
+{
+	if (count == 0)
+		return;
+
+	ParallelFor loop;
+	loop.system = this;
+	loop.function = function;
+	loop.data = data;
+	loop.minChunk = std::max(1u, minChunk);
+
+	splitJob(&loop, 0, count);
+	wait(loop.counter);
+}
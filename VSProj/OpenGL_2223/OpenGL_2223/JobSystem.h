@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//a job runs function(data, begin, end), the range is whatever the caller wants it to be
+typedef void (*JobFunction)(void* data, uint32_t begin, uint32_t end);
+
+//counts unfinished jobs, run() adds one and finishing the job takes it off again
+struct JobCounter
+{
+	std::atomic<int> pending{ 0 };
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	JobFunction function;
+	void* data;
+	uint32_t begin, end;
+	JobCounter* counter;		//signalled when the job is done, may be null
+	const JobCounter* after;	//job only starts once this is done, may be null
+	std::atomic<bool>* busy;	//the ring slot's flag, cleared once the job has finished
+};
+
+//chase-lev work stealing deque (le et al. 2013, "correct and efficient work-stealing for
+//weak memory models"). the owning thread pushes and pops at the bottom, everyone else
+//steals from the top, so the owner works depth first and thieves take the biggest jobs
+class WorkStealingDeque
+{
+public:
+	static const int64_t CAPACITY = 4096;
+
+	//owner only, false when full
+	bool push(Job* job);
+	Job* pop();
+	//any thread, null when empty or when another thief won the race
+	Job* steal();
+
+	//racy, only a hint for the owner
+	int64_t size() const { return bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed); }
+
+private:
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::atomic<Job*> buffer[CAPACITY];
+};
+
+struct JobSystemStats
+{
+	std::atomic<uint64_t> executed{ 0 };
+	std::atomic<uint64_t> stolen{ 0 };
+};
+
+//one worker per core, the thread that calls init() being worker 0. jobs go on the deque of
+//the thread that runs them and idle workers steal from the others. jobs are stored in a
+//ring per thread, so a thread can't have more than JOB_POOL_SIZE jobs in flight: when the
+//next slot's job is still running somewhere (or parked), run() helps out until it finishes
+//and runs the new job itself if it doesn't.
+//run() and wait() from a thread that isn't a worker just run the job there and then.
+//worker indices are per thread, so only one job system can be running at a time
+class JobSystem
+{
+public:
+	//0 threads is one per core
+	void init(int threads = 0);
+	void shutdown();
+	~JobSystem() { shutdown(); }
+
+	int getThreadCount() const { return (int)workers.size(); }
+	//this thread's worker index, -1 outside the job system
+	static int getThreadIndex();
+
+	void run(JobFunction function, void* data, uint32_t begin, uint32_t end, JobCounter* counter, const JobCounter* after = nullptr);
+	//runs other jobs while waiting
+	void wait(const JobCounter& counter);
+
+	//function over [0, count) split across the workers and waits for it. ranges are only
+	//split while the splitting thread's deque is nearly empty (lazy binary splitting), so
+	//chunks stay big while every worker is busy and get no smaller than minChunk
+	void parallelFor(uint32_t count, uint32_t minChunk, JobFunction function, void* data);
+	template <typename Body>
+	void parallelFor(uint32_t count, uint32_t minChunk, const Body& body)
+	{
+		parallelFor(count, minChunk, [](void* data, uint32_t begin, uint32_t end) { (*(const Body*)data)(begin, end); }, (void*)&body);
+	}
+
+	const JobSystemStats& getStats() const { return stats; }
+
+	static const uint32_t JOB_POOL_SIZE = 4096;
+
+private:
+	struct alignas(64) Worker
+	{
+		WorkStealingDeque deque;
+		std::unique_ptr<Job[]> jobs{ new Job[JOB_POOL_SIZE] };
+		std::unique_ptr<std::atomic<bool>[]> busy{ new std::atomic<bool>[JOB_POOL_SIZE]() };	//per slot in jobs
+		uint32_t nextJob = 0;
+		uint32_t random = 0;	//xorshift state for picking a victim
+		std::vector<Job*> parked;	//waiting on their after counter, only this worker sees them
+		std::thread thread;
+	};
+
+	struct ParallelFor;
+	static void splitJob(void* data, uint32_t begin, uint32_t end);
+
+	void workerLoop(int index);
+	//runs one job from this thread's deque or a stolen one, false if there was none
+	bool executeOne(int index);
+	//whether the parallel_for splitting on this thread should hand off more work
+	bool wantsSplit() const;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> running{ false };
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> sleeping{ 0 };
+
+	JobSystemStats stats;
+};
@@ -1,59 +1,501 @@
 #include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 //included glad before glfw
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "AssetIO.h"
+#include "AsyncProgram.h"
+#include "Benchmark.h"
+#include "Culling.h"
+#include "Entities.h"
+#include "FrameScheduler.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "Instancing.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshLod.h"
+#include "Memory.h"
+#include "Occlusion.h"
+#include "ProgramCache.h"
+#include "ProgramReflection.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderHotReload.h"
+#include "TextureStreamer.h"
+#include "UniformBuffer.h"
+
 //forward decs
 void processInput(GLFWwindow* window);
-int init(GLFWwindow*& window);
-
-void createTriangle(GLuint &vao, int &size);
+int init(GLFWwindow*& window, bool headless);
+void update(double dt);
+
+void createTriangle(Mesh& mesh);
+void createInstanceGrid(InstanceBatch& batch, int count);
+void createDrawGrid(std::vector<ObjectUniforms>& objects, int count);
+void createCullingSet(CullingSet& set, std::vector<Aabb>& bounds, const std::vector<ObjectUniforms>& objects);
+void createSceneNodes(Scene& scene, std::vector<NodeHandle>& nodes, const std::vector<ObjectUniforms>& objects);
+void createObjectEntities(EntityWorld& entities, const std::vector<ObjectUniforms>& objects, const std::vector<NodeHandle>& nodes);
+void syncSceneObjects(const Scene& scene, EntityWorld& entities, CullingSet& set, std::vector<Aabb>& bounds);
+void objectBounds(const float* model, float center[3], float& radius, Aabb& box);
+void createOccluderWall(std::vector<float>& positions, std::vector<uint32_t>& indices);
+std140::mat4 makeTransform(float scale, float x, float y);
 void createShaders();
-void createProgram(GLuint& programID, const char* vertex, const char* fragment);
+void createProgram(GLuint& programID, const char* vertex, const char* fragment, ProgramReflection* reflection = nullptr);
+ProgramHandle createProgramAsync(const char* vertex, const char* fragment);
 
 //util forward
-void loadFile(const char* filename, char*& output);
+std::string_view loadFile(const char* filename, MappedFile& file);
 
 //program IDs
-GLuint simpleProgram;
-
-int main()
+GLuint fallbackProgram;
+ProgramReflection fallbackReflection;
+ProgramHandle simpleProgram;
+ProgramHandle instancedProgram;
+ProgramHandle texturedProgram;
+
+//files from Shaders/manifest.txt, mapped in one go at startup
+AssetManifest assets;
+//linked program binaries from previous runs
+ProgramCache programCache("ShaderCache");
+//background shader compilation
+ProgramBuilder programBuilder;
+//--hot-reload rebuilds programs whose shader files change, off unless asked for
+ShaderHotReload shaderReload;
+//per-frame Frame/Object uniform blocks
+UniformRing uniforms;
+//background texture loading, uploads capped per frame
+TextureStreamer textureStreamer;
+const size_t TEXTURE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+//cpu/gpu scope timings, only on with --headless or --trace
+Profiler profiler;
+//one worker per core for the per-frame cpu work, the main thread is worker 0
+JobSystem jobs;
+//scratch memory for anything that only lives for a frame, one arena per job worker
+FrameAllocator frameMemory;
+//counts heap allocations per frame, steady state should have none
+HeapFrameCounter heapCounter;
+
+//components of a drawn object: its uniforms, the culling set slot with its bounds and
+//the level of detail it was drawn with last frame, for the hysteresis
+struct Renderable
 {
+	ObjectUniforms uniforms;
+	uint32_t cullIndex;
+	int lod;
+};
+//the scene node that places it
+struct SceneNode
+{
+	NodeHandle node;
+};
+
+//window size
+const int WIDTH = 1280;
+const int HEIGHT = 720;
+//cpu depth buffer for occlusion culling, a quarter of the window each way
+const int OCCLUSION_WIDTH = WIDTH / 4;
+const int OCCLUSION_HEIGHT = HEIGHT / 4;
+//--heightmap grid, 80x80 vertices like glfw's heightmap example, and its levels of detail
+const int HEIGHTMAP_SIZE = 79;
+const int HEIGHTMAP_LODS = 5;
+
+int main(int argc, char** argv)
+{
+	//--headless [frames] renders offscreen through osmesa and prints frame timings
+	//--instances n draws an n instance grid of triangles in one call instead of the single triangle
+	//--draws n draws the same grid as n separate draws, each with its own Object uniform block
+	//--mesh file.mesh draws a mesh made by MeshConverter instead of the triangle
+	//--heightmap draws a bumpy grid with levels of detail instead of the triangle
+	//--texture file.ppm|file.tga streams in a texture for the mesh
+	//--fps n caps the frame rate, handy with vsync off
+	//--bench name [size] runs one of the cpu benchmarks in Benchmark.cpp and exits
+	//--trace file.json writes profiler scopes for chrome://tracing or ui.perfetto.dev
+	//--no-state-cache sends every bind straight to the driver, to compare against
+	//--occluder puts an invisible wall over the left half of the draw grid for occlusion culling
+	//--hot-reload watches the shader files and rebuilds the programs that use them when they change
+	bool headless = false;
+	int headlessFrames = 1000;
+	int instanceCount = 0;
+	int drawCount = 0;
+	const char* meshPath = nullptr;
+	bool heightmap = false;
+	const char* texturePath = nullptr;
+	const char* tracePath = nullptr;
+	bool stateCache = true;
+	bool occluderWall = false;
+	bool hotReload = false;
+	FrameSchedulerSettings schedulerSettings;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				headlessFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+		{
+			instanceCount = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+		{
+			drawCount = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+		{
+			meshPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--heightmap") == 0)
+		{
+			heightmap = true;
+		}
+		else if (std::strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
+		{
+			texturePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			int fps = std::atoi(argv[++i]);
+			schedulerSettings.targetFrameTime = fps > 0 ? 1.0 / fps : 0.0;
+		}
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--no-state-cache") == 0)
+		{
+			stateCache = false;
+		}
+		else if (std::strcmp(argv[i], "--occluder") == 0)
+		{
+			occluderWall = true;
+		}
+		else if (std::strcmp(argv[i], "--hot-reload") == 0)
+		{
+			hotReload = true;
+		}
+		else if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[i + 1];
+			int size = i + 2 < argc ? std::atoi(argv[i + 2]) : 0;
+			return runBenchmark(name, size);
+		}
+	}
+
 	GLFWwindow* window;
-	int res = init(window);
+	int res = init(window, headless);
 	if (res != 0) return res;
 
-	GLuint triangleVAO;
-	int triangleSize;
-	createTriangle(triangleVAO, triangleSize);
-	//createSquare(triangleVAO, triangleSize);
+	jobs.init();
+	frameMemory.init(jobs.getThreadCount());
+
+	//drop redundant binds/state changes before they reach the driver
+	if (stateCache)
+		installStateCache();
+
+	if (headless || tracePath)
+	{
+		profiler.init(true);
+		if (tracePath && !profiler.openTrace(tracePath))
+			std::cout << "ERROR OPENING TRACE FILE " << tracePath << std::endl;
+	}
+
+	Mesh triangle;
+	if (heightmap)
+	{
+		MeshData data = createHeightmapMesh(HEIGHTMAP_SIZE);
+		optimiseMesh(data);
+		buildLods(data, HEIGHTMAP_LODS);
+		triangle = uploadMesh(data);
+	}
+	else if (meshPath == nullptr || !loadMeshFile(meshPath, triangle))
+		createTriangle(triangle);
+	//createSquare(triangle);
+	assets.load("Shaders/manifest.txt");
+	programCache.init();
+	programBuilder.init(&programCache);
+	if (hotReload)
+		shaderReload.init(&programBuilder);
 	createShaders();
 
+	InstanceBatch triangleInstances;
+	if (instanceCount > 0)
+	{
+		triangleInstances.init(triangle.vao, GL_TRIANGLES, triangle.indexCount, triangle.indexType);
+		createInstanceGrid(triangleInstances, instanceCount);
+	}
+
+	//per draw uniforms, uploaded to the ring every frame
+	std::vector<ObjectUniforms> objects;
+	if (drawCount > 0)
+	{
+		createDrawGrid(objects, drawCount);
+	}
+	else
+	{
+		ObjectUniforms object;
+		object.model = makeTransform(1.0f, 0.0f, 0.0f);
+		object.colour = { 1.0f, 0.5f, 0.2f, 1.0f };
+		objects.push_back(object);
+	}
+	//object transforms live in the scene, the uniforms get a copy when they change
+	Scene scene;
+	std::vector<NodeHandle> objectNodes;
+	createSceneNodes(scene, objectNodes, objects);
+	EntityWorld entities;
+	createObjectEntities(entities, objects, objectNodes);
+
+	//the Frame block plus one Object block per draw
+	uniforms.init((int)objects.size() + 1, sizeof(ObjectUniforms));
+
+	//bounds of every object, only the ones in the frustum get submitted
+	CullingSet cullingSet;
+	std::vector<Aabb> objectBounds;
+	createCullingSet(cullingSet, objectBounds, objects);
+	std::vector<uint32_t> visibleObjects;
+	//culling results by culling set index, looked up while walking the renderables
+	std::vector<uint8_t> objectVisible(objects.size(), 0);
+
+	//occluder meshes are only rasterised on the cpu, never drawn
+	OcclusionBuffer occlusion;
+	occlusion.init(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	std::vector<float> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
+	if (occluderWall)
+		createOccluderWall(occluderPositions, occluderIndices);
+
+	textureStreamer.init(TEXTURE_UPLOAD_BUDGET);
+	TextureHandle texture = 0;
+	if (texturePath)
+		texture = textureStreamer.request(texturePath);
+
 	//tell opengl to create viewport
-	glViewport(0, 0, 1280, 720);
+	glViewport(0, 0, WIDTH, HEIGHT);
+
+	//headless timings
+	FrameSampler frameTimes("frame");
+	FrameSampler drawTimes("draw");
+	FrameSampler readbackTimes("readback");
+	std::vector<unsigned char> pixels;
+	if (headless)
+	{
+		frameTimes.reserve(headlessFrames);
+		drawTimes.reserve(headlessFrames);
+		readbackTimes.reserve(headlessFrames);
+		pixels.resize(WIDTH * HEIGHT * 4);
+	}
+	int frame = 0;
+
+	RenderQueue renderQueue;
+
+	FrameScheduler scheduler;
+	scheduler.init(schedulerSettings);
 
 	//rendering loop
 	while (!glfwWindowShouldClose(window))
 	{
+		uint64_t frameStart = timerNow();
+		heapCounter.beginFrame();
+		scheduler.beginFrame();
+		profiler.beginFrame();
+		profiler.begin("frame");
+
 		//input
 		processInput(window);
 
+		//simulation runs at a fixed rate regardless of frame rate
+		scheduler.beginStage(STAGE_UPDATE);
+		profiler.begin("update");
+		while (scheduler.step())
+			update(scheduler.getFixedStep());
+		profiler.end();
+
+		//propagate whatever moved down the hierarchy
+		profiler.begin("scene");
+		if (scene.update(&jobs) > 0)
+			syncSceneObjects(scene, entities, cullingSet, objectBounds);
+		profiler.end();
+		scheduler.endStage(STAGE_UPDATE);
+
+		//pick up edited shaders and the programs that finished compiling, swapped in here between frames
+		profiler.begin("shader poll");
+		shaderReload.poll();
+		programBuilder.poll();
+		profiler.end();
+
+		//upload this frame's share of decoded texture levels
+		profiler.begin("texture streaming");
+		textureStreamer.update();
+		profiler.end();
+
 		// rendering
+		scheduler.beginStage(STAGE_RENDER);
+		profiler.begin("render", true);
 		glClearColor(0.2f, 0.4f, 0.5f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		glUseProgram(simpleProgram);
-
-		glBindVertexArray(triangleVAO);
-		glDrawArrays(GL_TRIANGLES, 0, triangleSize);
+		uint64_t drawStart = timerNow();
+
+		//everything the shaders read this frame goes into one buffer
+		uniforms.beginFrame();
+		FrameUniforms frameData;
+		frameData.viewProjection = makeTransform(1.0f, 0.0f, 0.0f);
+		frameData.time = { (float)glfwGetTime(), (float)scheduler.getDeltaTime(), 0.0f, 0.0f };
+		UniformRing::bind(FRAME_UNIFORM_BINDING, uniforms.push(frameData));
+
+		if (instanceCount > 0)
+		{
+			renderQueue.submit(triangleInstances.makePacket(programBuilder.get(instancedProgram, fallbackProgram)));
+		}
+		else
+		{
+			GLuint program = programBuilder.get(texturePath ? texturedProgram : simpleProgram, fallbackProgram);
+			GLuint material = texturePath ? textureStreamer.get(texture, 0) : 0;
+
+			profiler.begin("culling");
+			float* viewProjection = frameData.viewProjection.m;
+			cullingSet.cullBoxes(makeFrustum(viewProjection), visibleObjects);
+			profiler.end();
+
+			if (!occluderIndices.empty())
+			{
+				profiler.begin("occlusion");
+				occlusion.beginFrame(viewProjection);
+				occlusion.addOccluder(occluderPositions.data(), occluderPositions.size() / 3, occluderIndices.data(), occluderIndices.size());
+				occlusion.rasterize(&jobs);
+				occlusion.filterVisible(objectBounds, visibleObjects);
+				profiler.end();
+			}
+
+			//the render queue sorts, so the renderables can go in storage order
+			std::fill(objectVisible.begin(), objectVisible.end(), 0);
+			for (uint32_t index : visibleObjects)
+				objectVisible[index] = 1;
+
+			entities.each<Renderable>([&](Renderable& renderable)
+			{
+				if (!objectVisible[renderable.cullIndex])
+					return;
+
+				//smallest level whose error stays under a pixel at the object's size on screen
+				if (!triangle.lods.empty())
+				{
+					const float* model = renderable.uniforms.model.m;
+					float scale = std::sqrt(model[0] * model[0] + model[1] * model[1] + model[2] * model[2]);
+					float pixelsPerUnit = lodPixelsPerUnit(viewProjection, &model[12], scale, HEIGHT);
+					renderable.lod = selectLod(triangle.lods, pixelsPerUnit, renderable.lod);
+				}
+
+				UniformAllocation range = uniforms.push(renderable.uniforms);
+				DrawPacket packet = triangle.makePacket(program, material, 0.0f, renderable.lod);
+				packet.uniformBuffer = range.buffer;
+				packet.uniformOffset = range.offset;
+				packet.uniformSize = range.size;
+				renderQueue.submit(packet);
+			});
+		}
+		uniforms.flush();
+
+		profiler.begin("queue flush", true);
+		renderQueue.flush(frameMemory.local());
+		profiler.end();
+		uniforms.endFrame();
+
+		uint64_t drawEnd = timerNow();
+		profiler.end();
+		scheduler.endStage(STAGE_RENDER);
+
+		if (headless)
+		{
+			//read the frame back, this also waits for the gpu (or llvmpipe) to finish
+			profiler.begin("readback", true);
+			glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			profiler.end();
+			uint64_t readbackEnd = timerNow();
+
+			drawTimes.add(timerMs(drawStart, drawEnd));
+			readbackTimes.add(timerMs(drawEnd, readbackEnd));
+		}
 
 		//swap&poll
+		scheduler.beginStage(STAGE_PRESENT);
+		profiler.begin("present");
 		glfwSwapBuffers(window);
+		//nothing from this frame is needed past the swap
+		frameMemory.reset();
 		glfwPollEvents();
+		profiler.end();
+		scheduler.endStage(STAGE_PRESENT);
+
+		if (headless)
+		{
+			frameTimes.add(timerMs(frameStart, timerNow()));
+			if (++frame >= headlessFrames)
+				glfwSetWindowShouldClose(window, true);
+		}
+
+		profiler.end();
+		profiler.endFrame();
+		scheduler.endFrame();
+		heapCounter.endFrame();
+	}
+
+	if (headless)
+	{
+		frameTimes.report();
+		drawTimes.report();
+		readbackTimes.report();
+		scheduler.report();
+		heapCounter.report();
+
+		const RenderQueueStats& stats = renderQueue.getStats();
+		std::cout << "draws " << stats.draws << ", binds issued " << stats.bindsIssued
+			<< ", binds skipped " << stats.bindsSkipped << std::endl;
+
+		const ProgramCacheStats& cacheStats = programCache.getStats();
+		std::cout << "program cache hits " << cacheStats.hits << ", misses " << cacheStats.misses
+			<< ", rejected " << cacheStats.rejected << std::endl;
+
+		if (isStateCacheInstalled())
+		{
+			const GLStateCacheStats& stateStats = getStateCacheStats();
+			std::cout << "state cache hits " << stateStats.hits << ", misses " << stateStats.misses << std::endl;
+		}
+
+		profiler.printFrame();
+
+		if (texturePath)
+		{
+			const TextureStreamerStats& textureStats = textureStreamer.getStats();
+			std::cout << "texture uploaded " << textureStats.bytesTotal << " bytes, resident level "
+				<< textureStreamer.getResidentLevel(texture) << ", " << textureStats.resident << " resident" << std::endl;
+		}
+
+		fallbackReflection.print("fallback program");
+		if (programBuilder.getState(simpleProgram) == ProgramState::Ready)
+		{
+			const ProgramReflection& reflection = programBuilder.getReflection(simpleProgram);
+			reflection.print("simple program");
+			//the mesh vao layout is fixed, make sure the shader agrees
+			if (reflection.attributeLocation(SHADER_NAME("aPos")) != (GLint)MESH_POSITION_LOCATION)
+				std::cout << "ERROR simple program aPos isn't at location " << MESH_POSITION_LOCATION << std::endl;
+		}
 	}
 
+	profiler.shutdown();
+	textureStreamer.shutdown();
+	shaderReload.shutdown();
+	jobs.shutdown();
+	uniforms.destroy();
 	glfwTerminate();
 	return 0;
 }
@@ -64,7 +506,13 @@ void processInput(GLFWwindow* window)
 		glfwSetWindowShouldClose(window, true);
 }
 
-int init(GLFWwindow*& window)
+void update(double dt)
+{
+	//fixed rate game logic, render with scheduler.getAlpha() to interpolate between updates
+	(void)dt;
+}
+
+int init(GLFWwindow*& window, bool headless)
 {
 	//glfw init
 	glfwInit();
@@ -73,8 +521,16 @@ int init(GLFWwindow*& window)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
+	if (headless)
+	{
+		//hidden window with an osmesa context, works without a gpu or display
+		//(on linux build glfw with GLFW_USE_OSMESA to also drop the x11 dependency)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	}
+
 	//glfw window creation
-	window = glfwCreateWindow(1280, 720, "OpenGL_2223", NULL, NULL);
+	window = glfwCreateWindow(WIDTH, HEIGHT, "OpenGL_2223", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -89,51 +545,203 @@ int init(GLFWwindow*& window)
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	loadExtensions();
 
 	return 0;
 }
 
-void createTriangle(GLuint& vao, int& size)
+void createTriangle(Mesh& mesh)
 {
-	float vertices[] =
+	MeshData data;
+	data.positions =
 	{
 		-0.5f, -0.5f, 0.0f,
 		0.5f, -0.5f, 0.0f,
 		0.0f,  0.5f, 0.0f
 	};
+	data.indices = { 0, 1, 2 };
+
+	mesh = uploadMesh(data);
+}
+
+void createInstanceGrid(InstanceBatch& batch, int count)
+{
+	//lay the instances out in a square grid filling clip space
+	int side = 1;
+	while (side * side < count) side++;
+	float cell = 2.0f / side;
+
+	std::vector<float> transforms(count * 16, 0.0f);
+	std::vector<float> colours(count * 4);
+	for (int i = 0; i < count; i++)
+	{
+		int x = i % side, y = i / side;
+
+		//column-major scale + translation
+		float* m = &transforms[i * 16];
+		m[0] = cell;
+		m[5] = cell;
+		m[10] = 1.0f;
+		m[12] = -1.0f + cell * (x + 0.5f);
+		m[13] = -1.0f + cell * (y + 0.5f);
+		m[15] = 1.0f;
+
+		float* c = &colours[i * 4];
+		c[0] = (float)x / side;
+		c[1] = (float)y / side;
+		c[2] = 0.5f;
+		c[3] = 1.0f;
+	}
+
+	batch.upload(transforms.data(), colours.data(), count);
+}
+
+void createDrawGrid(std::vector<ObjectUniforms>& objects, int count)
+{
+	//same layout as createInstanceGrid
+	int side = 1;
+	while (side * side < count) side++;
+	float cell = 2.0f / side;
+
+	objects.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int x = i % side, y = i / side;
+		objects[i].model = makeTransform(cell, -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f));
+		objects[i].colour = { (float)x / side, (float)y / side, 0.5f, 1.0f };
+	}
+}
 
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+void createCullingSet(CullingSet& set, std::vector<Aabb>& bounds, const std::vector<ObjectUniforms>& objects)
+{
+	set.clear();
+	set.reserve(objects.size());
+	bounds.clear();
+	bounds.reserve(objects.size());
+	for (const ObjectUniforms& object : objects)
+	{
+		float center[3], radius;
+		Aabb box;
+		objectBounds(object.model.m, center, radius, box);
+		set.add(center, radius, box.min, box.max);
+		bounds.push_back(box);
+	}
+}
 
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+void objectBounds(const float* model, float center[3], float& radius, Aabb& box)
+{
+	//meshes aren't stored with bounds yet, assume they fit the unit cube around the origin
+	float half = 0.5f * std::sqrt(model[0] * model[0] + model[1] * model[1] + model[2] * model[2]);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = model[12 + axis];
+		box.min[axis] = center[axis] - half;
+		box.max[axis] = center[axis] + half;
+	}
+	radius = half * 1.7320508f;
+}
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+void createSceneNodes(Scene& scene, std::vector<NodeHandle>& nodes, const std::vector<ObjectUniforms>& objects)
+{
+	//every object hangs off one root, moving the root moves the lot
+	scene.reserve(objects.size() + 1);
+	NodeHandle root = scene.create();
+	nodes.clear();
+	nodes.reserve(objects.size());
+	for (const ObjectUniforms& object : objects)
+		nodes.push_back(scene.create(root, object.model.m));
+}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+void createObjectEntities(EntityWorld& entities, const std::vector<ObjectUniforms>& objects, const std::vector<NodeHandle>& nodes)
+{
+	//culling set indices follow the object order
+	for (size_t i = 0; i < objects.size(); i++)
+		entities.create(Renderable{ objects[i], (uint32_t)i, 0 }, SceneNode{ nodes[i] });
+}
 
-	size = sizeof(vertices);
+void syncSceneObjects(const Scene& scene, EntityWorld& entities, CullingSet& set, std::vector<Aabb>& bounds)
+{
+	entities.each<Renderable, SceneNode>([&](Renderable& renderable, SceneNode& node)
+	{
+		const float* world = scene.getWorld(node.node);
+		std::copy(world, world + 16, renderable.uniforms.model.m);
+
+		float center[3], radius;
+		Aabb& box = bounds[renderable.cullIndex];
+		objectBounds(world, center, radius, box);
+		set.setSphere(renderable.cullIndex, center, radius);
+		set.setBounds(renderable.cullIndex, box.min, box.max);
+	});
+}
+
+void createOccluderWall(std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+	//quad over the left half of clip space, in front of the grid at z = 0
+	positions = {
+		-1.0f, -1.0f, -0.5f,
+		0.0f, -1.0f, -0.5f,
+		0.0f, 1.0f, -0.5f,
+		-1.0f, 1.0f, -0.5f
+	};
+	indices = { 0, 1, 2, 0, 2, 3 };
+}
+
+std140::mat4 makeTransform(float scale, float x, float y)
+{
+	//column-major scale + translation
+	std140::mat4 m = {};
+	m.m[0] = scale;
+	m.m[5] = scale;
+	m.m[10] = 1.0f;
+	m.m[12] = x;
+	m.m[13] = y;
+	m.m[15] = 1.0f;
+	return m;
 }
 
 void createShaders()
 {
-	createProgram(simpleProgram, "Shaders/simpleVertex.shader", "Shaders/simpleFragment.shader");
+	//the fallback is tiny and built up front, everything else compiles in the background
+	createProgram(fallbackProgram, "Shaders/fallbackVertex.shader", "Shaders/fallbackFragment.shader", &fallbackReflection);
+	simpleProgram = createProgramAsync("Shaders/simpleVertex.shader", "Shaders/simpleFragment.shader");
+	instancedProgram = createProgramAsync("Shaders/instancedVertex.shader", "Shaders/instancedFragment.shader");
+	texturedProgram = createProgramAsync("Shaders/texturedVertex.shader", "Shaders/texturedFragment.shader");
+}
+
+ProgramHandle createProgramAsync(const char* vertex, const char* fragment)
+{
+	MappedFile vertexFile, fragmentFile;
+	std::string_view vertexSrc = loadFile(vertex, vertexFile);
+	std::string_view fragmentSrc = loadFile(fragment, fragmentFile);
+
+	ProgramHandle handle = programBuilder.submit(vertexSrc, fragmentSrc);
+	shaderReload.add(handle, vertex, fragment);
+	return handle;
 }
 
-void createProgram(GLuint& programID, const char* vertex, const char* fragment)
+void createProgram(GLuint& programID, const char* vertex, const char* fragment, ProgramReflection* reflection)
 {
 	//create a gl program with a vertex & fragment shader
-	char* vertexSrc;
-	char* fragmentSrc;
-	loadFile(vertex, vertexSrc);
-	loadFile(fragment, fragmentSrc);
+	MappedFile vertexFile, fragmentFile;
+	std::string_view vertexSrc = loadFile(vertex, vertexFile);
+	std::string_view fragmentSrc = loadFile(fragment, fragmentFile);
+
+	//skip compile & link entirely when the driver accepts a cached binary
+	uint64_t cacheKey = programCache.makeKey(vertexSrc, fragmentSrc);
+	if (programCache.load(programID, cacheKey))
+	{
+		bindUniformBlocks(programID);
+		if (reflection) reflection->reflect(programID);
+		return;
+	}
 
 	GLuint vertexShaderId, fragmentShaderID;
 
+	//mapped files aren't null terminated, pass the lengths explicitly
+	const char* src = vertexSrc.data();
+	GLint length = (GLint)vertexSrc.size();
 	vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShaderId, 1, &vertexSrc, nullptr);
+	glShaderSource(vertexShaderId, 1, &src, &length);
 	glCompileShader(vertexShaderId);
 
 	int success;
@@ -145,8 +753,10 @@ void createProgram(GLuint& programID, const char* vertex, const char* fragment)
 		std::cout << "ERROR COMPILING VERTEX SHADER\n" << infoLog << std::endl;
 	}
 
+	src = fragmentSrc.data();
+	length = (GLint)fragmentSrc.size();
 	fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShaderID, 1, &fragmentSrc, nullptr);
+	glShaderSource(fragmentShaderID, 1, &src, &length);
 	glCompileShader(fragmentShaderID);
 
 	glGetShaderiv(fragmentShaderID, GL_COMPILE_STATUS, &success);
@@ -159,6 +769,7 @@ void createProgram(GLuint& programID, const char* vertex, const char* fragment)
 	programID = glCreateProgram();
 	glAttachShader(programID, vertexShaderId);
 	glAttachShader(programID, fragmentShaderID);
+	programCache.prepareLink(programID);
 	glLinkProgram(programID);
 
 	glGetProgramiv(programID, GL_LINK_STATUS, &success);
@@ -167,32 +778,26 @@ void createProgram(GLuint& programID, const char* vertex, const char* fragment)
 		glGetProgramInfoLog(programID, 512, nullptr, infoLog);
 		std::cout << "ERROR LINKING PROGRAM\n" << infoLog << std::endl;
 	}
+	else
+	{
+		bindUniformBlocks(programID);
+		if (reflection) reflection->reflect(programID);
+		programCache.store(programID, cacheKey);
+	}
 
 	glDeleteShader(vertexShaderId);
 	glDeleteShader(fragmentShaderID);
-
-	delete vertexSrc;
-	delete fragmentSrc;
 }
 
-void loadFile(const char* filename, char*& output)
+std::string_view loadFile(const char* filename, MappedFile& file)
 {
-	std::ifstream file(filename, std::ios::binary); //open file
-
-	if (file.is_open())	//if the file was correctly opened
-	{
-		file.seekg(0, file.end); // get length of file
-		int length = file.tellg();
-		file.seekg(0, file.beg); // seek to start of file
-
-		output = new char[length +1]; //allocate memory for the char pointer
-		file.read(output, length); // read data as a block
-		output[length] = '\0'; // add null teminator to end of char pointer
-
-		file.close(); //close file
-	}
-	else
-	{
-		output = NULL; //if the file failed to open, set the char pointer to null
-	}
+	//files listed in the manifest are already mapped
+	const MappedFile* preloaded = assets.find(filename);
+	if (preloaded)
+		return preloaded->view();
+
+	//otherwise map it into the caller's file, the view lives as long as that does
+	if (!file.open(filename))
+		std::cout << "ERROR OPENING FILE " << filename << std::endl;
+	return file.view();
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "Memory.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+static std::atomic<uint64_t> heapAllocations{ 0 };
+static std::atomic<uint64_t> heapFrees{ 0 };
+static std::atomic<uint64_t> heapBytes{ 0 };
+
+HeapStats getHeapStats()
+{
+	HeapStats stats;
+	stats.allocations = heapAllocations.load(std::memory_order_relaxed);
+	stats.frees = heapFrees.load(std::memory_order_relaxed);
+	stats.bytes = heapBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void HeapFrameCounter::beginFrame()
+{
+	frameStart = getHeapStats();
+}
+
+void HeapFrameCounter::endFrame()
+{
+	HeapStats now = getHeapStats();
+	lastAllocations = now.allocations - frameStart.allocations;
+	if (++frames <= warmupFrames)
+		return;
+
+	allocations += lastAllocations;
+	bytes += now.bytes - frameStart.bytes;
+	worstFrame = std::max(worstFrame, lastAllocations);
+	allocatingFrames += lastAllocations > 0;
+}
+
+void HeapFrameCounter::report() const
+{
+	unsigned steadyFrames = frames > warmupFrames ? frames - warmupFrames : 0;
+	std::printf("heap: %llu allocations (%llu bytes) in %u of %u frames after warm up, at most %llu in a frame\n",
+		(unsigned long long)allocations, (unsigned long long)bytes, allocatingFrames, steadyFrames, (unsigned long long)worstFrame);
+}
+
+static void* countedAlloc(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	heapBytes.fetch_add(size, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+static void* countedAlignedAlloc(size_t size, size_t alignment)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	heapBytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, alignment);
+#else
+	//aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (std::max(size, (size_t)1) + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void countedFree(void* pointer)
+{
+	if (!pointer) return;
+	heapFrees.fetch_add(1, std::memory_order_relaxed);
+	std::free(pointer);
+}
+
+static void countedAlignedFree(void* pointer)
+{
+	if (!pointer) return;
+	heapFrees.fetch_add(1, std::memory_order_relaxed);
+#ifdef _MSC_VER
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+//replacements for the global allocation functions
+void* operator new(size_t size)
+{
+	void* pointer = countedAlloc(size);
+	if (!pointer) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	void* pointer = countedAlloc(size);
+	if (!pointer) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pointer = countedAlignedAlloc(size, (size_t)alignment);
+	if (!pointer) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* pointer = countedAlignedAlloc(size, (size_t)alignment);
+	if (!pointer) throw std::bad_alloc();
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { countedAlignedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { countedAlignedFree(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { countedAlignedFree(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { countedAlignedFree(pointer); }
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+	//first block from here on with room, blocks past the current one are empty after a reset
+	for (; currentBlock < blocks.size(); currentBlock++)
+	{
+		Block& block = blocks[currentBlock];
+		uintptr_t base = (uintptr_t)block.data.get();
+		size_t offset = ((base + block.used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+		if (offset + size <= block.size)
+		{
+			block.used = offset + size;
+			return block.data.get() + offset;
+		}
+	}
+
+	//oversized allocations get a block of their own
+	Block block;
+	block.size = std::max(blockSize, size + alignment);
+	block.data.reset(new unsigned char[block.size]);
+	block.used = 0;
+	blocks.push_back(std::move(block));
+	currentBlock = blocks.size() - 1;
+	return allocate(size, alignment);
+}
+
+void LinearArena::reset()
+{
+	for (Block& block : blocks)
+		block.used = 0;
+	currentBlock = 0;
+}
+
+size_t LinearArena::getUsed() const
+{
+	size_t used = 0;
+	for (const Block& block : blocks)
+		used += block.used;
+	return used;
+}
+
+size_t LinearArena::getCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+void FrameAllocator::init(int threads, size_t blockSize)
+{
+	arenas.clear();
+	for (int i = 0; i < std::max(threads, 1); i++)
+		arenas.push_back(std::make_unique<LinearArena>(blockSize));
+}
+
+LinearArena& FrameAllocator::local()
+{
+	int index = JobSystem::getThreadIndex();
+	return *arenas[index > 0 && index < (int)arenas.size() ? index : 0];
+}
+
+void FrameAllocator::reset()
+{
+	for (std::unique_ptr<LinearArena>& arena : arenas)
+		arena->reset();
+}
+
+size_t FrameAllocator::getUsed() const
+{
+	size_t used = 0;
+	for (const std::unique_ptr<LinearArena>& arena : arenas)
+		used += arena->getUsed();
+	return used;
+}
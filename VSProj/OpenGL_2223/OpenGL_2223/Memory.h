@@ -0,0 +1,162 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//every operator new/delete in the program goes through Memory.cpp and is counted here,
+//diff two snapshots to see what a frame allocated
+struct HeapStats
+{
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;		//total ever requested, not what's live
+};
+
+HeapStats getHeapStats();
+
+//heap traffic per frame. frames after the warm up (loading, first use of every pool and
+//scratch buffer) should allocate nothing, report() says which didn't
+class HeapFrameCounter
+{
+public:
+	explicit HeapFrameCounter(unsigned warmupFrames = 10) : warmupFrames(warmupFrames) {}
+
+	void beginFrame();
+	void endFrame();
+
+	uint64_t getLastFrameAllocations() const { return lastAllocations; }
+	void report() const;
+
+private:
+	unsigned warmupFrames;
+	unsigned frames = 0;
+	HeapStats frameStart;
+	uint64_t lastAllocations = 0;
+
+	//steady state frames only
+	unsigned allocatingFrames = 0;
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+	uint64_t worstFrame = 0;
+};
+
+//bump allocator. memory comes from blocks that are kept across reset(), so once it has
+//seen a frame's worth of allocations it never touches the heap again. nothing is
+//destructed, only use it for trivially destructible data
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	template <typename T>
+	T* allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+		return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void reset();
+
+	size_t getUsed() const;
+	size_t getCapacity() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+		size_t used;
+	};
+
+	std::vector<Block> blocks;
+	size_t currentBlock = 0;
+	size_t blockSize;
+};
+
+//one arena per job system worker so workers allocate without locking. reset once a frame
+//(at the buffer swap) when no jobs are running. only the job system's threads may use it
+class FrameAllocator
+{
+public:
+	void init(int threads, size_t blockSize = 256 * 1024);
+
+	//the calling worker's arena
+	LinearArena& local();
+	void reset();
+
+	size_t getUsed() const;
+
+private:
+	std::vector<std::unique_ptr<LinearArena>> arenas;
+};
+
+//fixed size objects with a free list threaded through the empty slots. pages of
+//PAGE_SIZE objects are allocated as needed and kept, so steady state create/destroy
+//never reaches the heap and objects never move. not thread safe
+template <typename T, size_t PAGE_SIZE = 256>
+class ObjectPool
+{
+public:
+	ObjectPool() = default;
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	template <typename... Args>
+	T* create(Args&&... args)
+	{
+		if (!freeList)
+			grow();
+		Slot* slot = freeList;
+		freeList = slot->next;
+		live++;
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object)
+	{
+		object->~T();
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		slot->next = freeList;
+		freeList = slot;
+		live--;
+	}
+
+	void reserve(size_t count)
+	{
+		while (pages.size() * PAGE_SIZE < count)
+			grow();
+	}
+
+	size_t size() const { return live; }
+	size_t capacity() const { return pages.size() * PAGE_SIZE; }
+
+private:
+	union Slot
+	{
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	void grow()
+	{
+		pages.emplace_back(new Slot[PAGE_SIZE]);
+		Slot* page = pages.back().get();
+		//linked back to front so the page is handed out in address order
+		for (size_t i = PAGE_SIZE; i-- > 0;)
+		{
+			page[i].next = freeList;
+			freeList = &page[i];
+		}
+	}
+
+	std::vector<std::unique_ptr<Slot[]>> pages;
+	Slot* freeList = nullptr;
+	size_t live = 0;
+};
@@ -0,0 +1,427 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+DrawPacket Mesh::makePacket(GLuint program, GLuint material, float depth, int lod) const
+{
+	DrawPacket packet = { program, vao, material, depth, GL_TRIANGLES, 0, indexCount };
+	packet.indexType = indexType;
+	if (lod > 0 && lod < (int)lods.size())
+	{
+		packet.first = (GLint)lods[lod].firstIndex;
+		packet.count = (GLsizei)lods[lod].indexCount;
+	}
+	return packet;
+}
+
+GLsizei encodeVertices(const MeshData& data, const MeshOptions& options, std::vector<unsigned char>& out)
+{
+	size_t vertexCount = data.vertexCount();
+	bool hasNormals = data.normals.size() == data.positions.size();
+
+	//interleaved position [normal]
+	GLsizei positionSize = options.halfPositions ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+	GLsizei normalSize = !hasNormals ? 0 : (options.octNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float));
+	GLsizei stride = positionSize + normalSize;
+
+	out.resize(vertexCount * stride);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		unsigned char* dst = &out[v * stride];
+		const float* position = &data.positions[v * 3];
+
+		if (options.halfPositions)
+		{
+			//w is padding so the next attribute stays 4 byte aligned
+			uint16_t half[4] = { floatToHalf(position[0]), floatToHalf(position[1]), floatToHalf(position[2]), floatToHalf(1.0f) };
+			std::memcpy(dst, half, sizeof(half));
+		}
+		else std::memcpy(dst, position, 3 * sizeof(float));
+
+		if (hasNormals)
+		{
+			const float* normal = &data.normals[v * 3];
+			if (options.octNormals)
+			{
+				int16_t oct[2];
+				octEncode(normal, oct);
+				std::memcpy(dst + positionSize, oct, sizeof(oct));
+			}
+			else std::memcpy(dst + positionSize, normal, 3 * sizeof(float));
+		}
+	}
+	return stride;
+}
+
+void setVertexLayout(GLsizei stride, const MeshOptions& options, bool hasNormals)
+{
+	GLsizei positionSize = options.halfPositions ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+
+	if (options.halfPositions)
+		glVertexAttribPointer(MESH_POSITION_LOCATION, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)0);
+	else
+		glVertexAttribPointer(MESH_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(MESH_POSITION_LOCATION);
+
+	if (hasNormals)
+	{
+		if (options.octNormals)
+			glVertexAttribPointer(MESH_NORMAL_LOCATION, 2, GL_SHORT, GL_TRUE, stride, (void*)(size_t)positionSize);
+		else
+			glVertexAttribPointer(MESH_NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)positionSize);
+		glEnableVertexAttribArray(MESH_NORMAL_LOCATION);
+	}
+}
+
+Mesh uploadMesh(const MeshData& data, const MeshOptions& options)
+{
+	Mesh mesh;
+	size_t vertexCount = data.vertexCount();
+	bool hasNormals = data.normals.size() == data.positions.size();
+
+	std::vector<unsigned char> vertices;
+	mesh.vertexStride = encodeVertices(data, options, vertices);
+
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	glGenBuffers(1, &mesh.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	setVertexLayout(mesh.vertexStride, options, hasNormals);
+
+	//16 bit indices halve index bandwidth whenever they're enough
+	glGenBuffers(1, &mesh.ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+	if (vertexCount <= 65536)
+	{
+		std::vector<uint16_t> shortIndices(data.indices.begin(), data.indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+		mesh.indexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(uint32_t), data.indices.data(), GL_STATIC_DRAW);
+		mesh.indexType = GL_UNSIGNED_INT;
+	}
+	//every level is in the buffer, a plain draw is level 0
+	mesh.lods = data.lods;
+	mesh.indexCount = (GLsizei)(data.lods.empty() ? data.indices.size() : data.lods[0].indexCount);
+
+	glBindVertexArray(0);
+	return mesh;
+}
+
+MeshData createGridMesh(int size)
+{
+	MeshData data;
+	int side = size + 1;
+	data.positions.reserve(side * side * 3);
+	data.normals.reserve(side * side * 3);
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			data.positions.push_back((float)x / size * 2.0f - 1.0f);
+			data.positions.push_back((float)y / size * 2.0f - 1.0f);
+			data.positions.push_back(0.0f);
+
+			data.normals.push_back(0.0f);
+			data.normals.push_back(0.0f);
+			data.normals.push_back(1.0f);
+		}
+	}
+
+	data.indices.reserve(size * size * 6);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			uint32_t i = y * side + x;
+			data.indices.insert(data.indices.end(), { i, i + 1, i + side });
+			data.indices.insert(data.indices.end(), { i + 1, i + side + 1, i + side });
+		}
+	}
+	return data;
+}
+
+MeshData createHeightmapMesh(int size, int bumps, unsigned seed)
+{
+	MeshData data = createGridMesh(size);
+	size_t vertexCount = data.vertexCount();
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int bump = 0; bump < bumps; bump++)
+	{
+		//raised cosine of random size and sign, about a tenth of the map across at most
+		float centerX = unit(rng) * 2.0f - 1.0f, centerY = unit(rng) * 2.0f - 1.0f;
+		float radius = unit(rng) * 0.2f;
+		float height = (unit(rng) < 0.1f ? -1.0f : 1.0f) * unit(rng) * 0.02f;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			float dx = data.positions[i * 3] - centerX, dy = data.positions[i * 3 + 1] - centerY;
+			float distance = std::sqrt(dx * dx + dy * dy) / radius;
+			if (distance <= 1.0f)
+				data.positions[i * 3 + 2] += height * (1.0f + std::cos(distance * 3.14159265f));
+		}
+	}
+
+	//normals from the neighbouring heights
+	int side = size + 1;
+	float spacing = 2.0f / size;
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			auto height = [&](int hx, int hy) { return data.positions[(std::max(0, std::min(side - 1, hy)) * side + std::max(0, std::min(side - 1, hx))) * 3 + 2]; };
+			float nx = (height(x - 1, y) - height(x + 1, y)) / (2.0f * spacing);
+			float ny = (height(x, y - 1) - height(x, y + 1)) / (2.0f * spacing);
+			float length = std::sqrt(nx * nx + ny * ny + 1.0f);
+			float* normal = &data.normals[(y * side + x) * 3];
+			normal[0] = nx / length;
+			normal[1] = ny / length;
+			normal[2] = 1.0f / length;
+		}
+	}
+	return data;
+}
+
+void destroyMesh(Mesh& mesh)
+{
+	glDeleteVertexArrays(1, &mesh.vao);
+	glDeleteBuffers(1, &mesh.vbo);
+	glDeleteBuffers(1, &mesh.ebo);
+	mesh = Mesh();
+}
+
+void optimiseMesh(MeshData& data)
+{
+	optimiseVertexCache(data.indices, data.vertexCount());
+	optimiseVertexFetch(data);
+}
+
+//next fanning vertex once the current one is exhausted: most recent dead end with
+//triangles left, otherwise scan forwards through the input order
+static int skipDeadEnd(const std::vector<unsigned>& liveTriangles, std::vector<uint32_t>& deadEnds, size_t& cursor, size_t vertexCount)
+{
+	while (!deadEnds.empty())
+	{
+		uint32_t vertex = deadEnds.back();
+		deadEnds.pop_back();
+		if (liveTriangles[vertex] > 0)
+			return (int)vertex;
+	}
+
+	while (cursor < vertexCount)
+	{
+		if (liveTriangles[cursor] > 0)
+			return (int)cursor;
+		cursor++;
+	}
+	return -1;
+}
+
+void optimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	//vertex -> triangles adjacency in one flat array
+	std::vector<unsigned> liveTriangles(vertexCount, 0);
+	for (uint32_t index : indices)
+		liveTriangles[index]++;
+
+	std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int corner = 0; corner < 3; corner++)
+			adjacency[fill[indices[t * 3 + corner]]++] = (uint32_t)t;
+
+	std::vector<unsigned> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	unsigned time = cacheSize + 1;
+	size_t cursor = 0;
+	int fanning = 0;
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		//emit every remaining triangle around the fanning vertex
+		for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+		{
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t v = indices[t * 3 + corner];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time;
+					time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		//pick the candidate that will still be in the cache and has the most triangles left
+		int best = -1;
+		int bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = (int)v;
+			}
+		}
+
+		fanning = best >= 0 ? best : skipDeadEnd(liveTriangles, deadEnds, cursor, vertexCount);
+	}
+
+	indices.swap(output);
+}
+
+void optimiseVertexFetch(MeshData& data)
+{
+	size_t vertexCount = data.vertexCount();
+	bool hasNormals = data.normals.size() == data.positions.size();
+
+	const uint32_t unused = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t next = 0;
+	for (uint32_t& index : data.indices)
+	{
+		if (remap[index] == unused)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	//vertices no index refers to are dropped
+	std::vector<float> positions(next * 3);
+	std::vector<float> normals(hasNormals ? next * 3 : 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unused)
+			continue;
+		std::memcpy(&positions[remap[v] * 3], &data.positions[v * 3], 3 * sizeof(float));
+		if (hasNormals)
+			std::memcpy(&normals[remap[v] * 3], &data.normals[v * 3], 3 * sizeof(float));
+	}
+
+	data.positions.swap(positions);
+	data.normals.swap(normals);
+}
+
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return 0.0f;
+
+	//fifo: a vertex is cached if fewer than cacheSize misses happened since it was loaded
+	std::vector<unsigned> loadedAt(vertexCount, 0);
+	unsigned misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (loadedAt[index] == 0 || misses - loadedAt[index] >= cacheSize)
+		{
+			misses++;
+			loadedAt[index] = misses;
+		}
+	}
+	return (float)misses / (float)triangleCount;
+}
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t floatExponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	int exponent = (int)floatExponent - 127 + 15;
+
+	//inf & nan
+	if (floatExponent == 0xFF)
+		return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+	//too big, clamp to inf
+	if (exponent >= 31)
+		return sign | 0x7C00;
+
+	//denormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return sign;
+
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
+	}
+
+	//round to nearest even, a carry into the exponent is still correct
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return sign | (uint16_t)half;
+}
+
+//glsl decode for the normal attribute:
+//	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//	float t = max(-n.z, 0.0);
+//	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+//	n = normalize(n);
+void octEncode(const float normal[3], int16_t out[2])
+{
+	float sum = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = sum > 0.0f ? normal[0] / sum : 0.0f;
+	float y = sum > 0.0f ? normal[1] / sum : 0.0f;
+
+	//fold the lower hemisphere over the diagonals
+	if (normal[2] < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	out[0] = (int16_t)std::lround(std::fmax(-1.0f, std::fmin(1.0f, x)) * 32767.0f);
+	out[1] = (int16_t)std::lround(std::fmax(-1.0f, std::fmin(1.0f, y)) * 32767.0f);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+
+//attribute locations, instancing uses 1-5
+const GLuint MESH_POSITION_LOCATION = 0;
+const GLuint MESH_NORMAL_LOCATION = 6;
+
+//a level of detail: its range of the index buffer and how far (object space) it strays from level 0
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+//cpu side indexed triangle list
+struct MeshData
+{
+	std::vector<float> positions;	//xyz per vertex
+	std::vector<float> normals;	//xyz per vertex, optional
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;	//level 0 first, empty when indices is a single level (see MeshLod.h)
+
+	size_t vertexCount() const { return positions.size() / 3; }
+};
+
+struct MeshOptions
+{
+	bool halfPositions = false;		//4x half float instead of 3x float
+	bool octNormals = false;		//2x snorm16 octahedral instead of 3x float, decode in the shader
+};
+
+//gpu side mesh, always indexed
+struct Mesh
+{
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_SHORT;	//GL_UNSIGNED_INT once there are more than 65536 vertices
+	GLsizei vertexStride = 0;
+	std::vector<MeshLod> lods;	//empty when there's only the full mesh
+
+	DrawPacket makePacket(GLuint program, GLuint material = 0, float depth = 0.0f, int lod = 0) const;
+};
+
+Mesh uploadMesh(const MeshData& data, const MeshOptions& options = MeshOptions());
+void destroyMesh(Mesh& mesh);
+
+//packs data into the interleaved vertex format uploadMesh uses, returns the stride
+GLsizei encodeVertices(const MeshData& data, const MeshOptions& options, std::vector<unsigned char>& out);
+//attribute pointers for that format on the bound vao & array buffer
+void setVertexLayout(GLsizei stride, const MeshOptions& options, bool hasNormals);
+
+//flat size x size quad grid over [-1, 1] in row order
+MeshData createGridMesh(int size);
+//the same grid raised into hills by random circular bumps (like glfw's heightmap example)
+MeshData createHeightmapMesh(int size, int bumps = 200, unsigned seed = 1);
+
+//both passes below, run once when the mesh is built rather than every load
+void optimiseMesh(MeshData& data);
+//tipsify (sander et al. 2007), reorders triangles so recently transformed vertices get reused
+void optimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = 16);
+//renumbers vertices in first-use order so vertex fetch walks memory forwards
+void optimiseVertexFetch(MeshData& data);
+//average cache miss ratio: transformed vertices per triangle with a fifo cache, 0.5 is ideal, 3 is worst
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = 16);
+
+//quantisation helpers
+uint16_t floatToHalf(float value);
+void octEncode(const float normal[3], int16_t out[2]);
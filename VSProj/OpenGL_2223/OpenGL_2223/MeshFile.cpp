@@ -0,0 +1,226 @@
+#include "MeshFile.h"
+#include "AssetIO.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+static void computeBounds(const MeshData& data, MeshFileSubmesh& submesh)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		submesh.boundsMin[axis] = FLT_MAX;
+		submesh.boundsMax[axis] = -FLT_MAX;
+	}
+
+	for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i++)
+	{
+		const float* position = &data.positions[data.indices[i] * 3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (position[axis] < submesh.boundsMin[axis]) submesh.boundsMin[axis] = position[axis];
+			if (position[axis] > submesh.boundsMax[axis]) submesh.boundsMax[axis] = position[axis];
+		}
+	}
+}
+
+bool writeMeshFile(const char* path, const MeshData& data, const MeshOptions& options, std::vector<MeshFileSubmesh> submeshes)
+{
+	bool hasNormals = !data.normals.empty() && data.normals.size() == data.positions.size();
+	bool wideIndices = data.vertexCount() > 65536;
+
+	if (submeshes.empty())
+	{
+		//one submesh per level of detail, or one for everything
+		if (data.lods.empty())
+			submeshes.push_back({ 0, (uint32_t)data.indices.size(), 0, 0, {}, {}, 0.0f, 0 });
+		for (size_t l = 0; l < data.lods.size(); l++)
+			submeshes.push_back({ data.lods[l].firstIndex, data.lods[l].indexCount, 0, (uint32_t)l, {}, {}, data.lods[l].error, 0 });
+	}
+	for (MeshFileSubmesh& submesh : submeshes)
+		computeBounds(data, submesh);
+
+	std::vector<unsigned char> vertices;
+	GLsizei stride = encodeVertices(data, options, vertices);
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.flags = (hasNormals ? MESH_FILE_HAS_NORMALS : 0)
+		| (options.halfPositions ? MESH_FILE_HALF_POSITIONS : 0)
+		| (hasNormals && options.octNormals ? MESH_FILE_OCT_NORMALS : 0)
+		| (wideIndices ? MESH_FILE_32BIT_INDICES : 0);
+	header.vertexStride = (uint32_t)stride;
+	header.vertexCount = (uint32_t)data.vertexCount();
+	header.indexCount = (uint32_t)data.indices.size();
+	header.submeshCount = (uint32_t)submeshes.size();
+	header.submeshOffset = alignUp(sizeof(MeshFileHeader));
+	header.vertexOffset = alignUp(header.submeshOffset + submeshes.size() * sizeof(MeshFileSubmesh));
+	header.vertexSize = vertices.size();
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexSize);
+	header.indexSize = data.indices.size() * (wideIndices ? sizeof(uint32_t) : sizeof(uint16_t));
+
+	std::vector<unsigned char> file(header.indexOffset + header.indexSize, 0);
+	std::memcpy(&file[0], &header, sizeof(header));
+	std::memcpy(&file[header.submeshOffset], submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+	if (!vertices.empty())
+		std::memcpy(&file[header.vertexOffset], vertices.data(), vertices.size());
+
+	//indices are stored at the width they'll be drawn with
+	unsigned char* indexDst = file.data() + header.indexOffset;
+	for (size_t i = 0; i < data.indices.size(); i++)
+	{
+		if (wideIndices)
+			std::memcpy(indexDst + i * 4, &data.indices[i], 4);
+		else
+		{
+			uint16_t index = (uint16_t)data.indices[i];
+			std::memcpy(indexDst + i * 2, &index, 2);
+		}
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "ERROR WRITING MESH FILE " << path << std::endl;
+		return false;
+	}
+	out.write((const char*)file.data(), file.size());
+	return (bool)out;
+}
+
+//written so a huge offset can't wrap around and pass
+static bool inFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool loadMeshFile(const char* path, Mesh& mesh, std::vector<MeshFileSubmesh>* submeshes)
+{
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(MeshFileHeader))
+	{
+		std::cout << "ERROR OPENING MESH FILE " << path << std::endl;
+		return false;
+	}
+
+	const unsigned char* base = (const unsigned char*)file.data();
+	const MeshFileHeader* header = (const MeshFileHeader*)base;
+
+	//only sanity checks, no parsing. the sizes have to agree with the counts before any of it reaches gl,
+	//and the stride has to be the one the flags describe (a 0 stride means tightly packed to gl)
+	uint64_t positionSize = (header->flags & MESH_FILE_HALF_POSITIONS) ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+	uint64_t normalSize = !(header->flags & MESH_FILE_HAS_NORMALS) ? 0
+		: ((header->flags & MESH_FILE_OCT_NORMALS) ? 2 * sizeof(int16_t) : 3 * sizeof(float));
+	uint64_t indexWidth = (header->flags & MESH_FILE_32BIT_INDICES) ? sizeof(uint32_t) : sizeof(uint16_t);
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION
+		|| header->submeshOffset > file.size()
+		|| header->submeshCount > (file.size() - header->submeshOffset) / sizeof(MeshFileSubmesh)
+		|| !inFile(header->vertexOffset, header->vertexSize, file.size())
+		|| !inFile(header->indexOffset, header->indexSize, file.size())
+		|| header->vertexStride != positionSize + normalSize
+		|| (uint64_t)header->vertexStride * header->vertexCount != header->vertexSize
+		|| (uint64_t)header->indexCount * indexWidth != header->indexSize)
+	{
+		std::cout << "ERROR INVALID MESH FILE " << path << std::endl;
+		return false;
+	}
+
+	//an index past the last vertex would have gl fetch outside the vertex buffer
+	const unsigned char* indexData = base + header->indexOffset;
+	for (uint32_t i = 0; i < header->indexCount; i++)
+	{
+		uint32_t index;
+		if (indexWidth == sizeof(uint32_t))
+			std::memcpy(&index, indexData + i * sizeof(uint32_t), sizeof(uint32_t));
+		else
+		{
+			uint16_t shortIndex;
+			std::memcpy(&shortIndex, indexData + i * sizeof(uint16_t), sizeof(uint16_t));
+			index = shortIndex;
+		}
+		if (index >= header->vertexCount)
+		{
+			std::cout << "ERROR INDEX " << index << " OUT OF RANGE IN MESH FILE " << path << std::endl;
+			return false;
+		}
+	}
+
+	MeshOptions options;
+	options.halfPositions = (header->flags & MESH_FILE_HALF_POSITIONS) != 0;
+	options.octNormals = (header->flags & MESH_FILE_OCT_NORMALS) != 0;
+
+	mesh = Mesh();
+	mesh.vertexStride = (GLsizei)header->vertexStride;
+	mesh.indexCount = (GLsizei)header->indexCount;
+
+	//every range has to be inside the index buffer, and there can't be more levels than submeshes
+	const MeshFileSubmesh* table = (const MeshFileSubmesh*)(base + header->submeshOffset);
+	for (uint32_t i = 0; i < header->submeshCount; i++)
+	{
+		const MeshFileSubmesh& submesh = table[i];
+		if (submesh.lod >= header->submeshCount || submesh.firstIndex > header->indexCount
+			|| submesh.indexCount > header->indexCount - submesh.firstIndex)
+		{
+			std::cout << "ERROR INVALID SUBMESH " << i << " IN MESH FILE " << path << std::endl;
+			return false;
+		}
+	}
+
+	//each level's submeshes are one contiguous index range
+	std::vector<uint32_t> lodSubmeshes;
+	for (uint32_t i = 0; i < header->submeshCount; i++)
+	{
+		const MeshFileSubmesh& submesh = table[i];
+		if (submesh.lod >= mesh.lods.size())
+		{
+			mesh.lods.resize(submesh.lod + 1, { submesh.firstIndex, 0, 0.0f });
+			lodSubmeshes.resize(submesh.lod + 1, 0);
+		}
+		lodSubmeshes[submesh.lod]++;
+		MeshLod& lod = mesh.lods[submesh.lod];
+		uint32_t end = std::max(lod.firstIndex + lod.indexCount, submesh.firstIndex + submesh.indexCount);
+		lod.firstIndex = std::min(lod.firstIndex, submesh.firstIndex);
+		lod.indexCount = end - lod.firstIndex;
+		lod.error = std::max(lod.error, submesh.lodError);
+	}
+	//a skipped level would be an empty draw selectLod could still pick
+	for (size_t l = 0; l < lodSubmeshes.size(); l++)
+	{
+		if (lodSubmeshes[l] == 0)
+		{
+			std::cout << "ERROR NO SUBMESH FOR LEVEL " << l << " IN MESH FILE " << path << std::endl;
+			return false;
+		}
+	}
+	if (mesh.lods.size() > 1)
+		mesh.indexCount = (GLsizei)mesh.lods[0].indexCount;
+	else
+		mesh.lods.clear();
+	mesh.indexType = (header->flags & MESH_FILE_32BIT_INDICES) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	glGenBuffers(1, &mesh.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header->vertexSize, base + header->vertexOffset, GL_STATIC_DRAW);
+	setVertexLayout(mesh.vertexStride, options, (header->flags & MESH_FILE_HAS_NORMALS) != 0);
+
+	glGenBuffers(1, &mesh.ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)header->indexSize, base + header->indexOffset, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+
+	if (submeshes)
+		submeshes->assign(table, table + header->submeshCount);
+	return true;
+}
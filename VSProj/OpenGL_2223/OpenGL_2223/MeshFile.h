@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+//binary mesh container (.mesh), little endian:
+//	header | submesh table | vertex blob | index blob
+//level of detail n of a submesh is another submesh entry with lod = n. all level 0 entries
+//come first and each level's entries are contiguous, in the table and in the index blob
+//every section starts on a MESH_FILE_ALIGNMENT boundary so the blobs can go from
+//the mapped file straight into glBufferData without any parsing or copying
+const uint32_t MESH_FILE_MAGIC = 0x4853454D;	//"MESH"
+const uint32_t MESH_FILE_VERSION = 2;
+const uint32_t MESH_FILE_ALIGNMENT = 64;
+
+//header flags
+const uint32_t MESH_FILE_HAS_NORMALS = 1 << 0;
+const uint32_t MESH_FILE_HALF_POSITIONS = 1 << 1;
+const uint32_t MESH_FILE_OCT_NORMALS = 1 << 2;
+const uint32_t MESH_FILE_32BIT_INDICES = 1 << 3;
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t submeshCount;
+	uint32_t reserved;
+	uint64_t submeshOffset;
+	uint64_t vertexOffset;
+	uint64_t vertexSize;
+	uint64_t indexOffset;
+	uint64_t indexSize;
+};
+static_assert(sizeof(MeshFileHeader) == 72, "mesh file header layout changed, bump MESH_FILE_VERSION");
+
+//a range of the index buffer drawn with one material
+struct MeshFileSubmesh
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t material;
+	uint32_t lod;
+	float boundsMin[3];
+	float boundsMax[3];
+	float lodError;		//object space, 0 for level 0
+	uint32_t reserved;
+};
+static_assert(sizeof(MeshFileSubmesh) == 48, "mesh file submesh layout changed, bump MESH_FILE_VERSION");
+
+//empty submeshes writes one submesh covering the whole index buffer
+bool writeMeshFile(const char* path, const MeshData& data, const MeshOptions& options, std::vector<MeshFileSubmesh> submeshes);
+
+//maps the file and uploads the blobs as they are, needs a current context. mesh.lods gets one
+//range per level covering all of that level's submeshes
+bool loadMeshFile(const char* path, Mesh& mesh, std::vector<MeshFileSubmesh>* submeshes = nullptr);
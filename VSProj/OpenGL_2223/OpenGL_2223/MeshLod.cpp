@@ -0,0 +1,286 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+//open edges (mesh borders and seams) get a plane pinning them in place, weighted so
+//the outline only moves once the inside has nothing cheaper left
+static const double BOUNDARY_WEIGHT = 10.0;
+static const uint32_t DEAD_TRIANGLE = 0xFFFFFFFF;
+
+//symmetric 4x4 matrix as its upper triangle
+struct Quadric
+{
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+
+	void addPlane(double a, double b, double c, double d, double weight)
+	{
+		a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+		b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+		c2 += weight * c * c; cd += weight * c * d;
+		d2 += weight * d * d;
+	}
+
+	void add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	//sum of squared distances from p to every plane that went in
+	double evaluate(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z + d2;
+		return std::max(error, 0.0);
+	}
+};
+
+struct Collapse
+{
+	double cost;
+	uint32_t from, to;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, double normal[3])
+{
+	double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+	double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+float simplifyMesh(const MeshData& data, uint32_t firstIndex, uint32_t indexCount, size_t targetIndexCount, std::vector<uint32_t>& out)
+{
+	const float* positions = data.positions.data();
+	size_t vertexCount = data.vertexCount();
+	std::vector<uint32_t> triangles(data.indices.begin() + firstIndex, data.indices.begin() + firstIndex + indexCount / 3 * 3);
+	size_t triangleCount = triangles.size() / 3;
+
+	//face planes into every corner's quadric, counting how many faces use each edge
+	std::vector<Quadric> quadrics(vertexCount);
+	std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(triangles.size());
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* tri = &triangles[t * 3];
+		double n[3];
+		triangleNormal(&positions[tri[0] * 3], &positions[tri[1] * 3], &positions[tri[2] * 3], n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0.0)
+		{
+			n[0] /= length; n[1] /= length; n[2] /= length;
+			const float* p = &positions[tri[0] * 3];
+			double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+			for (int corner = 0; corner < 3; corner++)
+				quadrics[tri[corner]].addPlane(n[0], n[1], n[2], d, 1.0);
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			vertexTriangles[tri[corner]].push_back((uint32_t)t);
+			edgeUses[edgeKey(tri[corner], tri[(corner + 1) % 3])]++;
+		}
+	}
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* tri = &triangles[t * 3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t a = tri[corner], b = tri[(corner + 1) % 3];
+			if (edgeUses[edgeKey(a, b)] != 1) continue;
+
+			//plane containing the edge, perpendicular to its face
+			double n[3], edge[3];
+			triangleNormal(&positions[tri[0] * 3], &positions[tri[1] * 3], &positions[tri[2] * 3], n);
+			for (int axis = 0; axis < 3; axis++)
+				edge[axis] = (double)positions[b * 3 + axis] - positions[a * 3 + axis];
+			double plane[3] = { edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0] };
+			double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length == 0.0) continue;
+
+			plane[0] /= length; plane[1] /= length; plane[2] /= length;
+			const float* p = &positions[a * 3];
+			double d = -(plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2]);
+			quadrics[a].addPlane(plane[0], plane[1], plane[2], d, BOUNDARY_WEIGHT);
+			quadrics[b].addPlane(plane[0], plane[1], plane[2], d, BOUNDARY_WEIGHT);
+		}
+	}
+
+	//cheaper direction of an edge collapse, both end up on an existing vertex
+	auto makeCollapse = [&](uint32_t a, uint32_t b)
+	{
+		Quadric q = quadrics[a];
+		q.add(quadrics[b]);
+		double toB = q.evaluate(&positions[b * 3]), toA = q.evaluate(&positions[a * 3]);
+		return toB <= toA ? Collapse{ toB, a, b } : Collapse{ toA, b, a };
+	};
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	for (const auto& edge : edgeUses)
+		queue.push(makeCollapse((uint32_t)(edge.first >> 32), (uint32_t)edge.first));
+
+	std::vector<bool> removed(vertexCount, false);
+	size_t liveTriangles = triangleCount;
+	double maxError = 0.0;
+	std::vector<uint32_t> neighbours;
+	while (liveTriangles * 3 > targetIndexCount && !queue.empty())
+	{
+		Collapse collapse = queue.top();
+		queue.pop();
+		if (removed[collapse.from] || removed[collapse.to])
+			continue;
+
+		//quadrics grew since this was queued, put it back with the real cost
+		Collapse current = makeCollapse(collapse.from, collapse.to);
+		if (current.cost > collapse.cost * 1.0000001 + 1e-12 || current.from != collapse.from)
+		{
+			queue.push(current);
+			continue;
+		}
+
+		//refuse collapses that would fold a face over
+		bool flips = false;
+		const float* target = &positions[collapse.to * 3];
+		for (uint32_t t : vertexTriangles[collapse.from])
+		{
+			uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == DEAD_TRIANGLE || tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+				continue;
+
+			const float* corners[3];
+			for (int corner = 0; corner < 3; corner++)
+				corners[corner] = &positions[tri[corner] * 3];
+			double before[3], after[3];
+			triangleNormal(corners[0], corners[1], corners[2], before);
+			for (int corner = 0; corner < 3; corner++)
+				if (tri[corner] == collapse.from) corners[corner] = target;
+			triangleNormal(corners[0], corners[1], corners[2], after);
+			if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+			{
+				flips = true;
+				break;
+			}
+		}
+		if (flips)
+			continue;
+
+		removed[collapse.from] = true;
+		quadrics[collapse.to].add(quadrics[collapse.from]);
+		maxError = std::max(maxError, collapse.cost);
+
+		for (uint32_t t : vertexTriangles[collapse.from])
+		{
+			uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == DEAD_TRIANGLE) continue;
+			for (int corner = 0; corner < 3; corner++)
+				if (tri[corner] == collapse.from) tri[corner] = collapse.to;
+
+			if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+			{
+				tri[0] = DEAD_TRIANGLE;
+				liveTriangles--;
+			}
+			else
+			{
+				vertexTriangles[collapse.to].push_back(t);
+			}
+		}
+		vertexTriangles[collapse.from].clear();
+
+		//the edges around the merged vertex all changed cost
+		neighbours.clear();
+		for (uint32_t t : vertexTriangles[collapse.to])
+		{
+			const uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == DEAD_TRIANGLE) continue;
+			for (int corner = 0; corner < 3; corner++)
+				if (tri[corner] != collapse.to) neighbours.push_back(tri[corner]);
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (uint32_t neighbour : neighbours)
+			queue.push(makeCollapse(collapse.to, neighbour));
+	}
+
+	for (size_t t = 0; t < triangleCount; t++)
+		if (triangles[t * 3] != DEAD_TRIANGLE)
+			out.insert(out.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+
+	//error is a sum of squared plane distances, its root bounds the distance to any one plane
+	return (float)std::sqrt(maxError);
+}
+
+void buildLods(MeshData& data, int levels, float reduction)
+{
+	data.lods.clear();
+	uint32_t baseCount = (uint32_t)data.indices.size();
+	data.lods.push_back({ 0, baseCount, 0.0f });
+
+	std::vector<uint32_t> level;
+	for (int l = 1; l < levels; l++)
+	{
+		//every level starts from the full mesh so errors don't stack up
+		size_t target = (size_t)(data.lods.back().indexCount * reduction) / 3 * 3;
+		level.clear();
+		float error = simplifyMesh(data, 0, baseCount, target, level);
+		if (level.empty() || level.size() >= data.lods.back().indexCount)
+			break;
+
+		optimiseVertexCache(level, data.vertexCount());
+		MeshLod lod = { (uint32_t)data.indices.size(), (uint32_t)level.size(), std::max(error, data.lods.back().error) };
+		data.indices.insert(data.indices.end(), level.begin(), level.end());
+		data.lods.push_back(lod);
+	}
+}
+
+float lodPixelsPerUnit(const float* m, const float center[3], float scale, int viewportHeight)
+{
+	//clip w grows with distance under a perspective projection and is 1 under an orthographic one
+	float w = m[3] * center[0] + m[7] * center[1] + m[11] * center[2] + m[15];
+	if (w <= 1e-6f)
+		return 1e30f;
+
+	//clip y per world unit, the length of the row keeps it independent of camera rotation
+	float clipPerUnit = std::sqrt(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+	return scale * clipPerUnit * 0.5f * viewportHeight / w;
+}
+
+int selectLod(const std::vector<MeshLod>& lods, float pixelsPerUnit, int current, float maxPixels, float hysteresis)
+{
+	int count = (int)lods.size();
+	if (count <= 1)
+		return 0;
+	current = std::max(0, std::min(current, count - 1));
+
+	//coarser only once that level is comfortably under the threshold
+	for (int l = count - 1; l > current; l--)
+		if (lods[l].error * pixelsPerUnit <= maxPixels * (1.0f - hysteresis))
+			return l;
+
+	//finer only once the current level is clearly over it
+	if (lods[current].error * pixelsPerUnit <= maxPixels * (1.0f + hysteresis))
+		return current;
+	for (int l = current - 1; l > 0; l--)
+		if (lods[l].error * pixelsPerUnit <= maxPixels)
+			return l;
+	return 0;
+}
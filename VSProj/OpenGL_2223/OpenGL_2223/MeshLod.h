@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+//offline: quadric error edge collapse (garland & heckbert 1997). vertices only ever collapse
+//onto other existing vertices, so every level shares the vertex buffer and only needs its
+//own indices. simplifies triangles [firstIndex, firstIndex + indexCount) of data down to
+//about targetIndexCount indices, appends them to out and returns the geometric error
+//(object space distance) of the result
+float simplifyMesh(const MeshData& data, uint32_t firstIndex, uint32_t indexCount, size_t targetIndexCount, std::vector<uint32_t>& out);
+
+//fills data.lods with levels ranges, level 0 being the current indices and each one after
+//having about reduction times the triangles of the level before. the simplified indices
+//are appended to data.indices and cache optimised. stops early once a level can't shrink
+void buildLods(MeshData& data, int levels, float reduction = 0.5f);
+
+//runtime: how many pixels one object space unit covers at center (world space) for a gl
+//clip space view-projection, scale is the model's scale
+float lodPixelsPerUnit(const float* viewProjection, const float center[3], float scale, int viewportHeight);
+
+//coarsest level whose error stays under maxPixels on screen. moving away from current needs
+//the error to clear the threshold by the hysteresis fraction, so objects sitting right on a
+//switch distance don't pop back and forth every frame
+int selectLod(const std::vector<MeshLod>& lods, float pixelsPerUnit, int current, float maxPixels = 1.0f, float hysteresis = 0.25f);
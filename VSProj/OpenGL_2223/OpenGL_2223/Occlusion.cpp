@@ -0,0 +1,309 @@
+#include "Occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_SSE 1
+#include <immintrin.h>
+#endif
+
+//vertices closer than this to the eye plane aren't projected, see addOccluder and testBox
+static const float MIN_W = 1e-5f;
+
+static void transformPoint(const float* m, float x, float y, float z, float out[4])
+{
+	for (int row = 0; row < 4; row++)
+		out[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z + m[12 + row];
+}
+
+//clamps to [0, limit] as a float first, converting something past int range is undefined
+//(and comes out as INT_MIN on x86). nan goes to 0
+static int toPixel(float value, int limit)
+{
+	return value > 0.0f ? (value < (float)limit ? (int)value : limit) : 0;
+}
+
+static void multiply(const float* a, const float* b, float* out)
+{
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			out[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1]
+				+ a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+}
+
+void OcclusionBuffer::init(int newWidth, int newHeight)
+{
+	tilesX = std::max(1, (newWidth + TILE_SIZE - 1) / TILE_SIZE);
+	tilesY = std::max(1, (newHeight + TILE_SIZE - 1) / TILE_SIZE);
+	width = tilesX * TILE_SIZE;
+	height = tilesY * TILE_SIZE;
+	bins.assign(tilesX * tilesY, std::vector<uint32_t>());
+
+	levels.clear();
+	levelWidth.clear();
+	levelHeight.clear();
+	int w = width, h = height;
+	while (true)
+	{
+		levels.emplace_back(w * h, 1.0f);
+		levelWidth.push_back(w);
+		levelHeight.push_back(h);
+		if (w == 1 && h == 1) break;
+		w = std::max(1, (w + 1) / 2);
+		h = std::max(1, (h + 1) / 2);
+	}
+
+	for (int i = 0; i < 16; i++)
+		viewProjection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+}
+
+void OcclusionBuffer::beginFrame(const float* newViewProjection)
+{
+	std::copy(newViewProjection, newViewProjection + 16, viewProjection);
+	triangles.clear();
+	scratch.reset();
+	for (std::vector<uint32_t>& bin : bins)
+		bin.clear();
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+}
+
+void OcclusionBuffer::addOccluder(const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* model)
+{
+	float matrix[16];
+	if (model)
+		multiply(viewProjection, model, matrix);
+	else
+		std::copy(viewProjection, viewProjection + 16, matrix);
+
+	//project every vertex once, w <= 0 marks the ones behind the eye
+	float* projected = scratch.allocate<float>(vertexCount * 3);
+	bool* behind = scratch.allocate<bool>(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		float clip[4];
+		transformPoint(matrix, positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], clip);
+		behind[i] = clip[3] < MIN_W || clip[2] < -clip[3];
+		if (behind[i]) continue;
+
+		float inverseW = 1.0f / clip[3];
+		projected[i * 3 + 0] = (clip[0] * inverseW * 0.5f + 0.5f) * width;
+		projected[i * 3 + 1] = (clip[1] * inverseW * 0.5f + 0.5f) * height;
+		projected[i * 3 + 2] = clip[2] * inverseW * 0.5f + 0.5f;
+	}
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		//no near plane clipping, a triangle crossing it is dropped. an occluder that is
+		//missing only makes culling less effective, never wrong
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount || behind[a] || behind[b] || behind[c])
+			continue;
+
+		Triangle triangle;
+		uint32_t corners[3] = { a, b, c };
+		for (int v = 0; v < 3; v++)
+		{
+			triangle.x[v] = projected[corners[v] * 3 + 0];
+			triangle.y[v] = projected[corners[v] * 3 + 1];
+			triangle.z[v] = projected[corners[v] * 3 + 2];
+		}
+
+		//occluders count from both sides, wind everything counter clockwise
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area == 0.0f) continue;
+		if (area < 0.0f)
+		{
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.z[1], triangle.z[2]);
+		}
+
+		float minX = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+		float maxX = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+		float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+		float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+		if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+			continue;
+
+		int tileX0 = toPixel(minX, width) / TILE_SIZE, tileX1 = std::min(tilesX - 1, toPixel(maxX, width) / TILE_SIZE);
+		int tileY0 = toPixel(minY, height) / TILE_SIZE, tileY1 = std::min(tilesY - 1, toPixel(maxY, height) / TILE_SIZE);
+		uint32_t index = (uint32_t)triangles.size();
+		triangles.push_back(triangle);
+		for (int y = tileY0; y <= tileY1; y++)
+			for (int x = tileX0; x <= tileX1; x++)
+				bins[y * tilesX + x].push_back(index);
+	}
+}
+
+void OcclusionBuffer::rasterize(JobSystem* jobs)
+{
+	//tiles don't share pixels so jobs never touch the same memory
+	uint32_t tileCount = (uint32_t)(tilesX * tilesY);
+	if (jobs)
+		jobs->parallelFor(tileCount, 1, [this](uint32_t begin, uint32_t end) { rasterizeTiles(begin, end); });
+	else
+		rasterizeTiles(0, tileCount);
+
+	buildPyramid();
+}
+
+void OcclusionBuffer::rasterizeTiles(uint32_t begin, uint32_t end)
+{
+	for (uint32_t tile = begin; tile < end; tile++)
+		for (uint32_t triangle : bins[tile])
+			rasterizeTriangle(triangles[triangle], tile % tilesX, tile / tilesX);
+}
+
+void OcclusionBuffer::rasterizeTriangle(const Triangle& t, int tileX, int tileY)
+{
+	//edge functions e = a*x + b*y + c, inside where all three are >= 0 (counter clockwise)
+	float a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int v0 = (e + 1) % 3, v1 = (e + 2) % 3;
+		a[e] = t.y[v0] - t.y[v1];
+		b[e] = t.x[v1] - t.x[v0];
+		c[e] = t.x[v0] * t.y[v1] - t.x[v1] * t.y[v0];
+	}
+	//edge e is opposite vertex e, so the edges over the area are the barycentrics
+	float area = c[0] + c[1] + c[2];
+	float za = (a[0] * t.z[0] + a[1] * t.z[1] + a[2] * t.z[2]) / area;
+	float zb = (b[0] * t.z[0] + b[1] * t.z[1] + b[2] * t.z[2]) / area;
+	float zc = (c[0] * t.z[0] + c[1] * t.z[1] + c[2] * t.z[2]) / area;
+
+	//bounding box clipped to the tile, x aligned down to 4 pixels for the simd loop
+	int x0 = std::max(tileX * TILE_SIZE, toPixel(std::floor(std::min({ t.x[0], t.x[1], t.x[2] })), width));
+	int x1 = std::min(tileX * TILE_SIZE + TILE_SIZE - 1, toPixel(std::ceil(std::max({ t.x[0], t.x[1], t.x[2] })), width));
+	int y0 = std::max(tileY * TILE_SIZE, toPixel(std::floor(std::min({ t.y[0], t.y[1], t.y[2] })), height));
+	int y1 = std::min(tileY * TILE_SIZE + TILE_SIZE - 1, toPixel(std::ceil(std::max({ t.y[0], t.y[1], t.y[2] })), height));
+	x0 &= ~3;
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	float* depth = levels[0].data();
+	for (int y = y0; y <= y1; y++)
+	{
+		float py = y + 0.5f;
+		float* row = depth + y * width;
+#ifdef OCCLUSION_SSE
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 px = _mm_add_ps(_mm_set1_ps((float)x0), offsets);
+		__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(b[0] * py + c[0]));
+		__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(b[1] * py + c[1]));
+		__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(b[2] * py + c[2]));
+		__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+		const __m128 step0 = _mm_set1_ps(a[0] * 4.0f), step1 = _mm_set1_ps(a[1] * 4.0f), step2 = _mm_set1_ps(a[2] * 4.0f);
+		const __m128 stepZ = _mm_set1_ps(za * 4.0f);
+
+		for (int x = x0; x <= x1; x += 4)
+		{
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside))
+			{
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+			e0 = _mm_add_ps(e0, step0);
+			e1 = _mm_add_ps(e1, step1);
+			e2 = _mm_add_ps(e2, step2);
+			z = _mm_add_ps(z, stepZ);
+		}
+#else
+		for (int x = x0; x <= x1; x++)
+		{
+			float px = x + 0.5f;
+			if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+				continue;
+			row[x] = std::min(row[x], za * px + zb * py + zc);
+		}
+#endif
+	}
+}
+
+void OcclusionBuffer::buildPyramid()
+{
+	//each texel keeps the farthest of the 2x2 below it
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const std::vector<float>& source = levels[level - 1];
+		int sourceWidth = levelWidth[level - 1], sourceHeight = levelHeight[level - 1];
+		std::vector<float>& target = levels[level];
+		for (int y = 0; y < levelHeight[level]; y++)
+		{
+			int sy0 = y * 2, sy1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for (int x = 0; x < levelWidth[level]; x++)
+			{
+				int sx0 = x * 2, sx1 = std::min(x * 2 + 1, sourceWidth - 1);
+				target[y * levelWidth[level] + x] = std::max(
+					std::max(source[sy0 * sourceWidth + sx0], source[sy0 * sourceWidth + sx1]),
+					std::max(source[sy1 * sourceWidth + sx0], source[sy1 * sourceWidth + sx1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::testBox(const Aabb& box, bool useHierarchy) const
+{
+	//screen rectangle and nearest depth of the eight corners
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float clip[4];
+		transformPoint(viewProjection, corner & 1 ? box.max[0] : box.min[0], corner & 2 ? box.max[1] : box.min[1],
+			corner & 4 ? box.max[2] : box.min[2], clip);
+		//crosses the near plane, the camera is practically inside it
+		if (clip[3] < MIN_W || clip[2] < -clip[3])
+			return true;
+
+		float inverseW = 1.0f / clip[3];
+		float x = (clip[0] * inverseW * 0.5f + 0.5f) * width;
+		float y = (clip[1] * inverseW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip[2] * inverseW * 0.5f + 0.5f);
+	}
+
+	//off screen is the frustum culler's business, and a nan rectangle can't be tested
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || !(minX <= maxX && minY <= maxY))
+		return true;
+
+	int x0 = toPixel(minX, width - 1), x1 = toPixel(maxX, width - 1);
+	int y0 = toPixel(minY, height - 1), y1 = toPixel(maxY, height - 1);
+
+	//go up until the rectangle covers at most 2x2 texels
+	size_t level = 0;
+	while (useHierarchy && level + 1 < levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+	{
+		level++;
+		x0 >>= 1;
+		x1 >>= 1;
+		y0 >>= 1;
+		y1 >>= 1;
+	}
+
+	const std::vector<float>& depth = levels[level];
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+			if (nearest <= depth[y * levelWidth[level] + x])
+				return true;
+	return false;
+}
+
+void OcclusionBuffer::filterVisible(const std::vector<Aabb>& bounds, std::vector<uint32_t>& indices) const
+{
+	if (triangles.empty())
+		return;
+
+	size_t count = 0;
+	for (uint32_t index : indices)
+	{
+		indices[count] = index;
+		count += testBox(bounds[index]);
+	}
+	indices.resize(count);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Culling.h"
+#include "JobSystem.h"
+#include "Memory.h"
+
+//cpu occlusion culling. a few big occluders (walls, floors, simplified proxies) are
+//rasterised into a small depth buffer, which is reduced into a hi-z pyramid of farthest
+//depths. a box is hidden when its nearest point is behind everything in the pyramid texels
+//it covers. depth is gl window depth, 0 near 1 far
+class OcclusionBuffer
+{
+public:
+	//width and height get rounded up to whole tiles
+	void init(int width, int height);
+
+	//clears the depth and the occluder list for this view
+	void beginFrame(const float* viewProjection);
+	//xyz positions, triangle list indices, column-major model matrix (null for identity)
+	void addOccluder(const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* model = nullptr);
+	//rasterises the binned tiles, spread over the job system's workers when there is one,
+	//then builds the pyramid
+	void rasterize(JobSystem* jobs = nullptr);
+
+	//false when the box is certainly hidden. useHierarchy = false checks every covered
+	//pixel of the full resolution buffer instead, which is slow but exact
+	bool testBox(const Aabb& box, bool useHierarchy = true) const;
+	//drops the hidden objects from indices
+	void filterVisible(const std::vector<Aabb>& bounds, std::vector<uint32_t>& indices) const;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	size_t getTriangleCount() const { return triangles.size(); }
+	const std::vector<float>& getDepth() const { return levels[0]; }
+
+	static const int TILE_SIZE = 32;
+
+private:
+	//screen space triangle, x/y in pixels and z as window depth
+	struct Triangle
+	{
+		float x[3], y[3], z[3];
+	};
+
+	void rasterizeTiles(uint32_t begin, uint32_t end);
+	void rasterizeTriangle(const Triangle& triangle, int tileX, int tileY);
+	void buildPyramid();
+
+	int width = 0, height = 0;
+	int tilesX = 0, tilesY = 0;
+	float viewProjection[16];
+
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> bins;	//triangle indices per tile, in submission order
+	std::vector<std::vector<float>> levels;		//level 0 is the depth buffer, each level after is half size
+	std::vector<int> levelWidth, levelHeight;
+	LinearArena scratch;	//projected occluder vertices, reset every frame
+};
@@ -0,0 +1,224 @@
+#include "Profiler.h"
+
+#include <GLFW/glfw3.h>
+
+void Profiler::init(bool gpu)
+{
+	enabled = true;
+	gpuEnabled = gpu;
+	frequency = glfwGetTimerFrequency();
+
+	if (gpuEnabled)
+	{
+		//gpu timestamps run on their own clock, line them up with the cpu one once
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		uint64_t cpuNow = ticksToNs(glfwGetTimerValue());
+		gpuToCpuOffsetNs = (int64_t)cpuNow - (int64_t)gpuNow;
+	}
+}
+
+void Profiler::shutdown()
+{
+	//the last PROFILER_LATENCY frames are still in flight, wait for them so they reach the trace
+	if (enabled)
+	{
+		endFrame();
+		for (uint64_t index = frameIndex + 1; index <= frameIndex + PROFILER_LATENCY; index++)
+			if (frames[index % PROFILER_LATENCY].pending)
+				resolve(frames[index % PROFILER_LATENCY], true);
+	}
+	closeTrace();
+
+	for (Frame& frame : frames)
+	{
+		if (!frame.queries.empty())
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		frame = Frame();
+	}
+	current = nullptr;
+	enabled = false;
+}
+
+uint64_t Profiler::ticksToNs(uint64_t ticks) const
+{
+	//split so ticks * 1e9 can't overflow
+	return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+}
+
+void Profiler::beginFrame()
+{
+	if (!enabled)
+		return;
+
+	frameIndex++;
+	current = &frames[frameIndex % PROFILER_LATENCY];
+
+	//this slot was last used PROFILER_LATENCY frames ago, its queries should be done by now
+	if (current->pending)
+		resolve(*current, false);
+
+	current->index = frameIndex;
+	current->scopes.clear();
+	current->usedQueries = 0;
+	current->pending = false;
+	stack.clear();
+}
+
+void Profiler::endFrame()
+{
+	if (!enabled || current == nullptr)
+		return;
+
+	//close anything left open so the tree stays consistent
+	while (!stack.empty())
+		end();
+
+	current->pending = true;
+	current = nullptr;
+}
+
+GLuint Profiler::allocQuery(Frame& frame)
+{
+	if (frame.usedQueries == frame.queries.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+	return frame.queries[frame.usedQueries++];
+}
+
+void Profiler::begin(const char* name, bool gpu)
+{
+	if (!enabled || current == nullptr)
+		return;
+
+	Scope scope = { name, (int)stack.size(), glfwGetTimerValue(), 0, { 0, 0 }, 0, 0 };
+	if (gpu && gpuEnabled)
+	{
+		//timestamps rather than GL_TIME_ELAPSED, elapsed queries can't nest
+		scope.gpuQueries[0] = allocQuery(*current);
+		glQueryCounter(scope.gpuQueries[0], GL_TIMESTAMP);
+	}
+
+	stack.push_back((int)current->scopes.size());
+	current->scopes.push_back(scope);
+}
+
+void Profiler::end()
+{
+	if (!enabled || current == nullptr || stack.empty())
+		return;
+
+	Scope& scope = current->scopes[stack.back()];
+	stack.pop_back();
+
+	if (scope.gpuQueries[0])
+	{
+		scope.gpuQueries[1] = allocQuery(*current);
+		glQueryCounter(scope.gpuQueries[1], GL_TIMESTAMP);
+	}
+	scope.cpuEnd = glfwGetTimerValue();
+}
+
+void Profiler::resolve(Frame& frame, bool wait)
+{
+	frame.gpuValid = true;
+	if (frame.usedQueries > 0)
+	{
+		//queries finish in order, so the last one being ready means they all are
+		GLint available = wait;
+		if (!wait)
+			glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			//don't stall, just lose this frame's gpu times
+			frame.gpuValid = false;
+			droppedGpuFrames++;
+		}
+		else
+		{
+			for (Scope& scope : frame.scopes)
+			{
+				if (scope.gpuQueries[0] == 0)
+					continue;
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(scope.gpuQueries[0], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(scope.gpuQueries[1], GL_QUERY_RESULT, &end);
+				scope.gpuStart = start;
+				scope.gpuEnd = end;
+			}
+		}
+	}
+
+	if (trace)
+		writeTrace(frame);
+
+	lastResolved.index = frame.index;
+	lastResolved.scopes = frame.scopes;
+	lastResolved.gpuValid = frame.gpuValid;
+	frame.pending = false;
+}
+
+bool Profiler::openTrace(const char* path)
+{
+	closeTrace();
+	trace = std::fopen(path, "w");
+	if (trace == nullptr)
+		return false;
+
+	std::fprintf(trace, "[\n");
+	std::fprintf(trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n");
+	std::fprintf(trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}");
+	firstEvent = false;
+	return true;
+}
+
+void Profiler::closeTrace()
+{
+	if (trace == nullptr)
+		return;
+
+	std::fprintf(trace, "\n]\n");
+	std::fclose(trace);
+	trace = nullptr;
+}
+
+void Profiler::writeTrace(const Frame& frame)
+{
+	for (const Scope& scope : frame.scopes)
+	{
+		double start = ticksToNs(scope.cpuStart) / 1000.0;
+		double duration = (ticksToNs(scope.cpuEnd) - ticksToNs(scope.cpuStart)) / 1000.0;
+		std::fprintf(trace, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+			firstEvent ? "" : ",", scope.name, start, duration, (unsigned long long)frame.index);
+		firstEvent = false;
+
+		if (scope.gpuQueries[0] && frame.gpuValid)
+		{
+			double gpuStart = ((int64_t)scope.gpuStart + gpuToCpuOffsetNs) / 1000.0;
+			double gpuDuration = (scope.gpuEnd - scope.gpuStart) / 1000.0;
+			std::fprintf(trace, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+				scope.name, gpuStart, gpuDuration, (unsigned long long)frame.index);
+		}
+	}
+}
+
+void Profiler::printFrame() const
+{
+	if (lastResolved.scopes.empty())
+		return;
+
+	std::printf("profile of frame %llu\n", (unsigned long long)lastResolved.index);
+	for (const Scope& scope : lastResolved.scopes)
+	{
+		double cpuMs = (ticksToNs(scope.cpuEnd) - ticksToNs(scope.cpuStart)) / 1000000.0;
+		std::printf("%*s%-*s cpu %8.3f ms", scope.depth * 2, "", 20 - scope.depth * 2, scope.name, cpuMs);
+		if (scope.gpuQueries[0] && lastResolved.gpuValid)
+			std::printf("  gpu %8.3f ms", (scope.gpuEnd - scope.gpuStart) / 1000000.0);
+		std::printf("\n");
+	}
+	if (droppedGpuFrames)
+		std::printf("%u frames had gpu results that weren't ready in time\n", droppedGpuFrames);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <glad/glad.h>
+
+//hierarchical cpu/gpu frame profiler.
+//cpu scopes use glfwGetTimerValue, gpu scopes put GL_TIMESTAMP queries around the
+//commands and are read back PROFILER_LATENCY frames later so nothing stalls.
+//scope names must be string literals (or otherwise outlive the profiler)
+class Profiler
+{
+public:
+	static const int PROFILER_LATENCY = 4;
+
+	//needs a current context when gpu is true
+	void init(bool gpu);
+	void shutdown();
+	bool isEnabled() const { return enabled; }
+
+	void beginFrame();
+	void endFrame();
+
+	void begin(const char* name, bool gpu = false);
+	void end();
+
+	//streams every completed frame as chrome trace events (chrome://tracing, perfetto)
+	bool openTrace(const char* path);
+	void closeTrace();
+
+	//indented tree of the newest frame with gpu results
+	void printFrame() const;
+
+private:
+	struct Scope
+	{
+		const char* name;
+		int depth;
+		uint64_t cpuStart, cpuEnd;
+		GLuint gpuQueries[2];	//0 for cpu only scopes
+		uint64_t gpuStart, gpuEnd;
+	};
+
+	struct Frame
+	{
+		uint64_t index = 0;
+		std::vector<Scope> scopes;
+		std::vector<GLuint> queries;	//pool, reused every PROFILER_LATENCY frames
+		size_t usedQueries = 0;
+		bool pending = false;
+		bool gpuValid = false;
+	};
+
+	GLuint allocQuery(Frame& frame);
+	//wait blocks on the gpu results instead of dropping them when they aren't ready
+	void resolve(Frame& frame, bool wait);
+	uint64_t ticksToNs(uint64_t ticks) const;
+	void writeTrace(const Frame& frame);
+
+	bool enabled = false;
+	bool gpuEnabled = false;
+	uint64_t frequency = 1;
+	int64_t gpuToCpuOffsetNs = 0;
+
+	Frame frames[PROFILER_LATENCY];
+	Frame* current = nullptr;
+	uint64_t frameIndex = 0;
+	std::vector<int> stack;
+
+	Frame lastResolved;
+	unsigned droppedGpuFrames = 0;
+
+	FILE* trace = nullptr;
+	bool firstEvent = true;
+};
+
+//profiles the enclosing block
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler& profiler, const char* name, bool gpu = false) : profiler(profiler) { profiler.begin(name, gpu); }
+	~ProfileScope() { profiler.end(); }
+
+private:
+	Profiler& profiler;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(profiler, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, name)
+#define PROFILE_GPU_SCOPE(profiler, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, name, true)
@@ -0,0 +1,171 @@
+#include "ProgramCache.h"
+#include "GLExtensions.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+//file layout: header followed by the raw program binary
+struct ProgramBinaryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t length;
+};
+
+static const uint32_t CACHE_MAGIC = 0x4E494250; //"PBIN"
+static const uint32_t CACHE_VERSION = 1;
+
+//fnv-1a plus a 0 separator so "ab"+"c" and "a"+"bc" hash differently
+static uint64_t fnv1a(uint64_t hash, std::string_view str)
+{
+	for (char c : str)
+	{
+		hash ^= (unsigned char)c;
+		hash *= 0x100000001B3ull;
+	}
+	return hash * 0x100000001B3ull;
+}
+
+ProgramCache::ProgramCache(const char* directory) : directory(directory)
+{
+}
+
+void ProgramCache::init()
+{
+	enabled = false;
+	if (!glExt.programBinary)
+		return;
+
+	//some drivers expose the extension but no formats
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0)
+		return;
+
+	driver = (const char*)glGetString(GL_VENDOR);
+	driver += '|';
+	driver += (const char*)glGetString(GL_RENDERER);
+	driver += '|';
+	driver += (const char*)glGetString(GL_VERSION);
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cout << "ERROR CREATING SHADER CACHE DIRECTORY " << directory << std::endl;
+		return;
+	}
+
+	enabled = true;
+}
+
+uint64_t ProgramCache::makeKey(std::string_view vertexSrc, std::string_view fragmentSrc) const
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = fnv1a(hash, vertexSrc);
+	hash = fnv1a(hash, fragmentSrc);
+	hash = fnv1a(hash, driver);
+	return hash;
+}
+
+std::string ProgramCache::pathFor(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+bool ProgramCache::load(GLuint& programID, uint64_t key)
+{
+	if (!enabled)
+		return false;
+
+	std::string path = pathFor(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		stats.misses++;
+		return false;
+	}
+
+	ProgramBinaryHeader header;
+	std::vector<char> binary;
+	bool valid = file.read((char*)&header, sizeof(header))
+		&& header.magic == CACHE_MAGIC && header.version == CACHE_VERSION;
+	//the length has to match what's left of the file before it's trusted with an allocation
+	std::error_code sizeError;
+	uint64_t fileSize = std::filesystem::file_size(path, sizeError);
+	valid = valid && !sizeError && fileSize >= sizeof(header) && header.length == fileSize - sizeof(header);
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = (bool)file.read(binary.data(), header.length);
+	}
+	file.close();
+
+	if (valid)
+	{
+		programID = glCreateProgram();
+		glExt.programBinaryLoad(programID, header.format, binary.data(), (GLsizei)header.length);
+
+		int success;
+		glGetProgramiv(programID, GL_LINK_STATUS, &success);
+		if (success)
+		{
+			stats.hits++;
+			return true;
+		}
+		glDeleteProgram(programID);
+		programID = 0;
+	}
+
+	//driver update or corrupt file, drop it so it gets rebuilt
+	stats.rejected++;
+	std::error_code error;
+	std::filesystem::remove(path, error);
+	return false;
+}
+
+void ProgramCache::prepareLink(GLuint programID)
+{
+	if (enabled)
+		glExt.programParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(GLuint programID, uint64_t key)
+{
+	if (!enabled)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glExt.getProgramBinary(programID, length, nullptr, &format, binary.data());
+
+	ProgramBinaryHeader header = { CACHE_MAGIC, CACHE_VERSION, format, (uint32_t)length };
+
+	//write to a temp file first so a crash never leaves half a binary behind
+	std::string path = pathFor(key);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return;
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <glad/glad.h>
+
+struct ProgramCacheStats
+{
+	unsigned hits = 0;
+	unsigned misses = 0;
+	unsigned rejected = 0;	//binary on disk was refused by the driver
+};
+
+//stores linked program binaries on disk, keyed by the shader sources and the driver
+class ProgramCache
+{
+public:
+	explicit ProgramCache(const char* directory);
+
+	//needs a current context, disables the cache when binaries aren't supported
+	void init();
+	bool isEnabled() const { return enabled; }
+
+	//hash of both sources and the driver, call after init()
+	uint64_t makeKey(std::string_view vertexSrc, std::string_view fragmentSrc) const;
+
+	//try to create programID from a cached binary, false means compile from source
+	bool load(GLuint& programID, uint64_t key);
+
+	//call before glLinkProgram so the driver keeps the binary around
+	void prepareLink(GLuint programID);
+	//write a successfully linked program to the cache
+	void store(GLuint programID, uint64_t key);
+
+	const ProgramCacheStats& getStats() const { return stats; }
+
+private:
+	std::string pathFor(uint64_t key) const;
+
+	std::string directory;
+	std::string driver;
+	bool enabled = false;
+	ProgramCacheStats stats;
+};
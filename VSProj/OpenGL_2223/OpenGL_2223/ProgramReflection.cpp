@@ -0,0 +1,188 @@
+#include "ProgramReflection.h"
+
+#include <cstdio>
+#include <iostream>
+
+bool PerfectHashTable::build(const std::vector<uint32_t>& input)
+{
+	keys.clear();
+	slots.clear();
+	if (input.empty())
+		return true;
+
+	//equal keys can't be told apart, leave them all out and keep the rest
+	std::vector<bool> duplicate(input.size(), false);
+	bool unique = true;
+	for (size_t i = 0; i < input.size(); i++)
+		for (size_t j = i + 1; j < input.size(); j++)
+			if (input[i] == input[j])
+			{
+				duplicate[i] = duplicate[j] = true;
+				unique = false;
+			}
+
+	//start at twice the key count, a sparse table finds a seed in a few tries
+	uint32_t bits = 1;
+	while ((1u << bits) < input.size() * 2) bits++;
+
+	for (;; bits++)
+	{
+		uint32_t size = 1u << bits;
+		for (uint32_t attempt = 0; attempt < 256; attempt++)
+		{
+			seed = attempt * 0x9E3779B9u;
+			shift = 32 - bits;
+			keys.assign(size, 0);
+			slots.assign(size, -1);
+
+			bool collided = false;
+			for (size_t i = 0; i < input.size() && !collided; i++)
+			{
+				if (duplicate[i]) continue;
+				uint32_t slot = ((input[i] ^ seed) * 2654435761u) >> shift;
+				if (slots[slot] != -1) collided = true;
+				keys[slot] = input[i];
+				slots[slot] = (int16_t)i;
+			}
+			if (!collided)
+			{
+				//empty slots must never match, give them a key that hashes elsewhere
+				for (uint32_t slot = 0; slot < size; slot++)
+				{
+					if (slots[slot] != -1) continue;
+					keys[slot] = 0;
+					while ((((keys[slot] ^ seed) * 2654435761u) >> shift) == slot) keys[slot]++;
+				}
+				return unique;
+			}
+		}
+	}
+}
+
+//array uniforms are reported as name[0], look them up by the plain name
+static std::string baseName(const char* name, GLsizei length)
+{
+	std::string result(name, length);
+	if (result.size() > 3 && result.compare(result.size() - 3, 3, "[0]") == 0)
+		result.resize(result.size() - 3);
+	return result;
+}
+
+void ProgramReflection::clear()
+{
+	uniforms.clear();
+	attributes.clear();
+	blocks.clear();
+	uniformTable.build({});
+	attributeTable.build({});
+	blockTable.build({});
+}
+
+void ProgramReflection::reflect(GLuint program)
+{
+	clear();
+
+	char name[256];
+	GLsizei length;
+	GLint size;
+	GLenum type;
+
+	GLint count = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		glGetActiveUniform(program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+
+		GLuint index = (GLuint)i;
+		GLint block, offset;
+		glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+		glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+
+		ReflectedUniform uniform = { baseName(name, length), -1, type, size, block, offset };
+		if (block == -1)
+			uniform.location = glGetUniformLocation(program, name);
+		uniforms.push_back(uniform);
+	}
+
+	count = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		glGetActiveAttrib(program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+		ReflectedAttribute attribute = { baseName(name, length), glGetAttribLocation(program, name), type, size };
+		attributes.push_back(attribute);
+	}
+
+	count = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		glGetActiveUniformBlockName(program, (GLuint)i, sizeof(name), &length, name);
+		ReflectedBlock block = { std::string(name, length), (GLuint)i, 0, 0 };
+		glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+		glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+		blocks.push_back(block);
+	}
+
+	//names with the same 32 bit hash aren't found (only those), every other name still is
+	std::vector<uint32_t> hashes;
+	for (const ReflectedUniform& uniform : uniforms) hashes.push_back(nameHash(uniform.name));
+	if (!uniformTable.build(hashes))
+		std::cout << "ERROR REFLECTING PROGRAM " << program << ": uniform name hash collision" << std::endl;
+
+	hashes.clear();
+	for (const ReflectedAttribute& attribute : attributes) hashes.push_back(nameHash(attribute.name));
+	if (!attributeTable.build(hashes))
+		std::cout << "ERROR REFLECTING PROGRAM " << program << ": attribute name hash collision" << std::endl;
+
+	hashes.clear();
+	for (const ReflectedBlock& block : blocks) hashes.push_back(nameHash(block.name));
+	if (!blockTable.build(hashes))
+		std::cout << "ERROR REFLECTING PROGRAM " << program << ": block name hash collision" << std::endl;
+}
+
+const ReflectedUniform* ProgramReflection::findUniform(uint32_t name) const
+{
+	int index = uniformTable.find(name);
+	return index >= 0 ? &uniforms[index] : nullptr;
+}
+
+const ReflectedAttribute* ProgramReflection::findAttribute(uint32_t name) const
+{
+	int index = attributeTable.find(name);
+	return index >= 0 ? &attributes[index] : nullptr;
+}
+
+const ReflectedBlock* ProgramReflection::findBlock(uint32_t name) const
+{
+	int index = blockTable.find(name);
+	return index >= 0 ? &blocks[index] : nullptr;
+}
+
+GLint ProgramReflection::uniformLocation(uint32_t name) const
+{
+	const ReflectedUniform* uniform = findUniform(name);
+	return uniform ? uniform->location : -1;
+}
+
+GLint ProgramReflection::attributeLocation(uint32_t name) const
+{
+	const ReflectedAttribute* attribute = findAttribute(name);
+	return attribute ? attribute->location : -1;
+}
+
+void ProgramReflection::print(const char* label) const
+{
+	std::printf("%s: %zu uniforms, %zu attributes, %zu blocks\n", label, uniforms.size(), attributes.size(), blocks.size());
+	for (const ReflectedBlock& block : blocks)
+		std::printf("  block %-16s %4d bytes, binding %d\n", block.name.c_str(), block.dataSize, block.binding);
+	for (const ReflectedUniform& uniform : uniforms)
+	{
+		if (uniform.block >= 0)
+			std::printf("  uniform %-14s block %d offset %d\n", uniform.name.c_str(), uniform.block, uniform.offset);
+		else
+			std::printf("  uniform %-14s location %d\n", uniform.name.c_str(), uniform.location);
+	}
+	for (const ReflectedAttribute& attribute : attributes)
+		std::printf("  attribute %-12s location %d\n", attribute.name.c_str(), attribute.location);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <glad/glad.h>
+
+//fnv-1a, constexpr so names used in code hash at compile time
+constexpr uint32_t nameHash(std::string_view name)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : name)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//forces the hash to be a compile time constant: reflection.uniformLocation(SHADER_NAME("model"))
+#define SHADER_NAME(name) (std::integral_constant<uint32_t, nameHash(name)>::value)
+
+//perfect hash over a fixed key set: one multiply, one shift, one compare per lookup.
+//build() searches for a seed that puts every key in its own slot of a table at least twice
+//the key count, so it isn't minimal
+class PerfectHashTable
+{
+public:
+	//false if two keys are equal, those keys are left out and the rest still resolve
+	bool build(const std::vector<uint32_t>& keys);
+	//index of the key in the vector given to build, -1 if it wasn't in it
+	int find(uint32_t key) const
+	{
+		if (slots.empty()) return -1;
+		uint32_t slot = ((key ^ seed) * 2654435761u) >> shift;
+		return keys[slot] == key ? slots[slot] : -1;
+	}
+
+private:
+	std::vector<uint32_t> keys;
+	std::vector<int16_t> slots;	//-1 when empty
+	uint32_t seed = 0;
+	uint32_t shift = 32;
+};
+
+struct ReflectedUniform
+{
+	std::string name;	//arrays without the [0]
+	GLint location;		//-1 inside a block
+	GLenum type;
+	GLint size;			//array length, 1 otherwise
+	GLint block;		//uniform block index, -1 for default block uniforms
+	GLint offset;		//byte offset in the block
+};
+
+struct ReflectedAttribute
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint size;
+};
+
+struct ReflectedBlock
+{
+	std::string name;
+	GLuint index;
+	GLint dataSize;
+	GLint binding;
+};
+
+//what a linked program exposes, queried once with glGetActiveUniform & co so nothing
+//asks the driver for a location by string while rendering
+class ProgramReflection
+{
+public:
+	//program must be linked
+	void reflect(GLuint program);
+	void clear();
+
+	const ReflectedUniform* findUniform(uint32_t name) const;
+	const ReflectedAttribute* findAttribute(uint32_t name) const;
+	const ReflectedBlock* findBlock(uint32_t name) const;
+
+	//-1 when the program doesn't use it, like glGetUniformLocation
+	GLint uniformLocation(uint32_t name) const;
+	GLint attributeLocation(uint32_t name) const;
+
+	const std::vector<ReflectedUniform>& getUniforms() const { return uniforms; }
+	const std::vector<ReflectedAttribute>& getAttributes() const { return attributes; }
+	const std::vector<ReflectedBlock>& getBlocks() const { return blocks; }
+
+	void print(const char* label) const;
+
+private:
+	std::vector<ReflectedUniform> uniforms;
+	std::vector<ReflectedAttribute> attributes;
+	std::vector<ReflectedBlock> blocks;
+
+	PerfectHashTable uniformTable;
+	PerfectHashTable attributeTable;
+	PerfectHashTable blockTable;
+};
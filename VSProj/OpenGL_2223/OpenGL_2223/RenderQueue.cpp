@@ -0,0 +1,141 @@
+#include "RenderQueue.h"
+
+#include "UniformBuffer.h"
+
+#include <utility>
+
+void RenderQueue::submit(const DrawPacket& packet)
+{
+	packets.push_back(packet);
+	keys.push_back(makeKey(packet));
+}
+
+uint64_t RenderQueue::makeKey(const DrawPacket& packet)
+{
+	//program | material | vao | depth, 16 bits each
+	//names are truncated which only affects ordering, binds still compare the full name
+	float depth = packet.depth < 0.0f ? 0.0f : (packet.depth > 1.0f ? 1.0f : packet.depth);
+	uint64_t quantDepth = (uint64_t)(depth * 65535.0f);
+
+	return ((uint64_t)(packet.program & 0xFFFF) << 48)
+		| ((uint64_t)(packet.material & 0xFFFF) << 32)
+		| ((uint64_t)(packet.vao & 0xFFFF) << 16)
+		| quantDepth;
+}
+
+const uint32_t* RenderQueue::sort(LinearArena& scratch)
+{
+	size_t count = keys.size();
+	uint32_t* order = scratch.allocate<uint32_t>(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = (uint32_t)i;
+
+	//passes ping-pong between these and keys/order
+	uint64_t* sortKeys = keys.data();
+	uint64_t* keyScratch = scratch.allocate<uint64_t>(count);
+	uint32_t* orderScratch = scratch.allocate<uint32_t>(count);
+
+	//lsd radix sort, 8 bits per pass
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = {};
+		for (size_t i = 0; i < count; i++)
+			histogram[(sortKeys[i] >> shift) & 0xFF]++;
+
+		//every key has the same digit, nothing to do this pass
+		if (histogram[(sortKeys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			size_t n = histogram[d];
+			histogram[d] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t dst = histogram[(sortKeys[i] >> shift) & 0xFF]++;
+			keyScratch[dst] = sortKeys[i];
+			orderScratch[dst] = order[i];
+		}
+
+		std::swap(sortKeys, keyScratch);
+		std::swap(order, orderScratch);
+	}
+	return order;
+}
+
+void RenderQueue::draw(const DrawPacket& packet)
+{
+	if (packet.indexType)
+	{
+		size_t indexSize = packet.indexType == GL_UNSIGNED_INT ? 4 : (packet.indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+		void* offset = (void*)(packet.first * indexSize);
+		if (packet.instances > 1)
+			glDrawElementsInstanced(packet.mode, packet.count, packet.indexType, offset, packet.instances);
+		else
+			glDrawElements(packet.mode, packet.count, packet.indexType, offset);
+	}
+	else
+	{
+		if (packet.instances > 1)
+			glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instances);
+		else
+			glDrawArrays(packet.mode, packet.first, packet.count);
+	}
+}
+
+void RenderQueue::flush(LinearArena& scratch)
+{
+	if (packets.empty())
+		return;
+
+	const uint32_t* order = sort(scratch);
+
+	//state isn't tracked across flushes, so the first packet always binds
+	GLuint boundProgram = 0, boundVAO = 0, boundMaterial = 0;
+	bool first = true;
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		const DrawPacket& packet = packets[order[i]];
+
+		if (first || packet.program != boundProgram)
+		{
+			glUseProgram(packet.program);
+			boundProgram = packet.program;
+			stats.bindsIssued++;
+		}
+		else stats.bindsSkipped++;
+
+		if (first || packet.material != boundMaterial)
+		{
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, packet.material);
+			boundMaterial = packet.material;
+			stats.bindsIssued++;
+		}
+		else stats.bindsSkipped++;
+
+		if (first || packet.vao != boundVAO)
+		{
+			glBindVertexArray(packet.vao);
+			boundVAO = packet.vao;
+			stats.bindsIssued++;
+		}
+		else stats.bindsSkipped++;
+
+		//per draw data, always a new range so there's nothing to skip
+		if (packet.uniformSize > 0)
+			glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORM_BINDING, packet.uniformBuffer, packet.uniformOffset, packet.uniformSize);
+
+		draw(packet);
+		stats.draws++;
+		first = false;
+	}
+
+	packets.clear();
+	keys.clear();
+}
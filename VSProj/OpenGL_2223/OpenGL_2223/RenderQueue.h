@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Memory.h"
+
+//one draw call with the state it needs
+struct DrawPacket
+{
+	GLuint program;
+	GLuint vao;
+	GLuint material;	//texture bound to unit 0, 0 for none
+	float depth;		//0 = near, 1 = far
+	GLenum mode;
+	GLint first;		//first vertex, or first index when indexed
+	GLsizei count;
+	GLenum indexType = 0;	//0 draws with glDrawArrays
+	GLsizei instances = 0;	//0 or 1 for a normal draw
+	GLuint uniformBuffer = 0;	//Object uniform block range, bound per draw when uniformSize > 0
+	GLintptr uniformOffset = 0;
+	GLsizeiptr uniformSize = 0;
+};
+
+struct RenderQueueStats
+{
+	unsigned draws = 0;
+	unsigned bindsIssued = 0;
+	unsigned bindsSkipped = 0;
+};
+
+//collects draw packets for a frame, sorts them by state and issues them
+//without rebinding state that is already bound
+class RenderQueue
+{
+public:
+	void submit(const DrawPacket& packet);
+	//sort buffers come from scratch, they're dead once the packets are issued
+	void flush(LinearArena& scratch);
+
+	const RenderQueueStats& getStats() const { return stats; }
+	void resetStats() { stats = RenderQueueStats(); }
+
+	static uint64_t makeKey(const DrawPacket& packet);
+	//just the draw call, the packet's state has to be bound already
+	static void draw(const DrawPacket& packet);
+
+private:
+	//packet indices in key order
+	const uint32_t* sort(LinearArena& scratch);
+
+	std::vector<DrawPacket> packets;
+	std::vector<uint64_t> keys;
+
+	RenderQueueStats stats;
+};
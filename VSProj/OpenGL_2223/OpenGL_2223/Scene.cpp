@@ -0,0 +1,319 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCENE_SSE 1
+#include <immintrin.h>
+#endif
+
+static const Transform IDENTITY = { { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+
+//out = a * b, column-major
+static void multiply(const Transform& a, const Transform& b, Transform& out)
+{
+#ifdef SCENE_SSE
+	__m128 c0 = _mm_load_ps(a.m);
+	__m128 c1 = _mm_load_ps(a.m + 4);
+	__m128 c2 = _mm_load_ps(a.m + 8);
+	__m128 c3 = _mm_load_ps(a.m + 12);
+	for (int column = 0; column < 4; column++)
+	{
+		const float* bc = b.m + column * 4;
+		__m128 r = _mm_mul_ps(c0, _mm_set1_ps(bc[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(bc[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(bc[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(bc[3])));
+		_mm_store_ps(out.m + column * 4, r);
+	}
+#else
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			out.m[column * 4 + row] = a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1]
+				+ a.m[8 + row] * b.m[column * 4 + 2] + a.m[12 + row] * b.m[column * 4 + 3];
+#endif
+}
+
+void Scene::reserve(size_t count)
+{
+	parents.reserve(count);
+	subtreeSizes.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	nodeHandles.reserve(count);
+	handleIndex.reserve(count);
+	handleDirty.reserve(count);
+	dirtyNodes.reserve(count);
+}
+
+NodeHandle Scene::create(NodeHandle parent, const float* local)
+{
+	NodeHandle node;
+	if (!freeHandles.empty())
+	{
+		node = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		node = (NodeHandle)handleIndex.size();
+		handleIndex.push_back(NO_NODE);
+		handleDirty.push_back(0);
+	}
+
+	uint32_t index = (uint32_t)worlds.size();
+	uint32_t parentIndex = parent == NO_NODE ? NO_NODE : handleIndex[parent];
+	handleIndex[node] = index;
+	parents.push_back(parentIndex);
+	subtreeSizes.push_back(1);
+	locals.push_back(IDENTITY);
+	if (local)
+		std::copy(local, local + 16, locals.back().m);
+	worlds.push_back(IDENTITY);
+	nodeHandles.push_back(node);
+	liveCount++;
+
+	//appending keeps the order when the parent's subtree runs to the end of the arrays,
+	//which is the case when a hierarchy is built depth first. otherwise sort at the update
+	if (parentIndex != NO_NODE && !orderChanged)
+	{
+		if (parentIndex + subtreeSizes[parentIndex] == index)
+		{
+			for (uint32_t i = parentIndex; i != NO_NODE; i = parents[i])
+				subtreeSizes[i]++;
+		}
+		else
+			orderChanged = true;
+	}
+
+	markDirty(node);
+	return node;
+}
+
+void Scene::destroy(NodeHandle node)
+{
+	uint32_t index = handleIndex[node];
+	nodeHandles[index] = NO_NODE;
+	handleIndex[node] = NO_NODE;
+	freeHandles.push_back(node);
+	liveCount--;
+	orderChanged = true;
+}
+
+bool Scene::setParent(NodeHandle node, NodeHandle parent)
+{
+	uint32_t index = handleIndex[node];
+	uint32_t parentIndex = parent == NO_NODE ? NO_NODE : handleIndex[parent];
+	for (uint32_t i = parentIndex; i != NO_NODE; i = parents[i])
+	{
+		if (i == index)
+		{
+			std::cout << "ERROR SCENE NODE " << node << " CAN'T BE PARENTED TO ITS OWN DESCENDANT " << parent << std::endl;
+			return false;
+		}
+	}
+
+	parents[index] = parentIndex;
+	orderChanged = true;
+	markDirty(node);
+	return true;
+}
+
+void Scene::setLocal(NodeHandle node, const float* local)
+{
+	std::copy(local, local + 16, locals[handleIndex[node]].m);
+	markDirty(node);
+}
+
+NodeHandle Scene::getParent(NodeHandle node) const
+{
+	uint32_t parent = parents[handleIndex[node]];
+	return parent == NO_NODE ? NO_NODE : nodeHandles[parent];
+}
+
+void Scene::markDirty(NodeHandle node)
+{
+	if (handleDirty[node])
+		return;
+	handleDirty[node] = 1;
+	dirtyNodes.push_back(node);
+}
+
+void Scene::sortNodes()
+{
+	uint32_t count = (uint32_t)worlds.size();
+
+	//children of every node, in index order (counting sort on the parent)
+	childStart.assign(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+		if (nodeHandles[i] != NO_NODE && parents[i] != NO_NODE)
+			childStart[parents[i] + 1]++;
+	for (uint32_t i = 0; i < count; i++)
+		childStart[i + 1] += childStart[i];
+	children.resize(childStart[count]);
+	remap.assign(childStart.begin(), childStart.end() - 1);
+	for (uint32_t i = 0; i < count; i++)
+		if (nodeHandles[i] != NO_NODE && parents[i] != NO_NODE)
+			children[remap[parents[i]]++] = i;
+
+	//depth first from every root. destroyed nodes aren't visited, and neither is anything below them
+	order.clear();
+	scratchIndices.clear();
+	for (uint32_t i = count; i-- > 0;)
+		if (nodeHandles[i] != NO_NODE && parents[i] == NO_NODE)
+			scratchIndices.push_back(i);
+	while (!scratchIndices.empty())
+	{
+		uint32_t i = scratchIndices.back();
+		scratchIndices.pop_back();
+		order.push_back(i);
+		for (uint32_t c = childStart[i + 1]; c-- > childStart[i];)
+			if (nodeHandles[children[c]] != NO_NODE)
+				scratchIndices.push_back(children[c]);
+	}
+
+	remap.assign(count, NO_NODE);
+	for (uint32_t i = 0; i < (uint32_t)order.size(); i++)
+		remap[order[i]] = i;
+
+	//descendants of destroyed nodes go with them
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (remap[i] == NO_NODE && nodeHandles[i] != NO_NODE)
+		{
+			handleIndex[nodeHandles[i]] = NO_NODE;
+			freeHandles.push_back(nodeHandles[i]);
+			liveCount--;
+		}
+	}
+
+	uint32_t sorted = (uint32_t)order.size();
+	scratchIndices.resize(sorted);
+	for (uint32_t i = 0; i < sorted; i++)
+		scratchIndices[i] = parents[order[i]] == NO_NODE ? NO_NODE : remap[parents[order[i]]];
+	parents.swap(scratchIndices);
+	scratchIndices.resize(sorted);
+	for (uint32_t i = 0; i < sorted; i++)
+		scratchIndices[i] = nodeHandles[order[i]];
+	nodeHandles.swap(scratchIndices);
+
+	scratchTransforms.resize(sorted);
+	for (uint32_t i = 0; i < sorted; i++)
+		scratchTransforms[i] = locals[order[i]];
+	locals.swap(scratchTransforms);
+	scratchTransforms.resize(sorted);
+	for (uint32_t i = 0; i < sorted; i++)
+		scratchTransforms[i] = worlds[order[i]];
+	worlds.swap(scratchTransforms);
+
+	//children come after their parent, so sizes add up back to front
+	subtreeSizes.assign(sorted, 1);
+	for (uint32_t i = sorted; i-- > 0;)
+		if (parents[i] != NO_NODE)
+			subtreeSizes[parents[i]] += subtreeSizes[i];
+
+	for (uint32_t i = 0; i < sorted; i++)
+		handleIndex[nodeHandles[i]] = i;
+	orderChanged = false;
+}
+
+void Scene::splitRange(Range range)
+{
+	//a range is one subtree or a run of siblings whose parent is done. big subtrees get their
+	//root computed here and their children grouped into runs of about SPLIT_SIZE nodes
+	splitStack.push_back(range);
+	while (!splitStack.empty())
+	{
+		Range r = splitStack.back();
+		splitStack.pop_back();
+		if (r.end - r.begin <= SPLIT_SIZE)
+		{
+			work.push_back(r);
+			continue;
+		}
+
+		computeWorlds(r.begin, r.begin + 1);
+		uint32_t runStart = r.begin + 1;
+		for (uint32_t child = r.begin + 1; child < r.end; child += subtreeSizes[child])
+		{
+			uint32_t childEnd = child + subtreeSizes[child];
+			if (childEnd - runStart > SPLIT_SIZE && child > runStart)
+			{
+				work.push_back({ runStart, child });
+				runStart = child;
+			}
+			if (childEnd - child > SPLIT_SIZE)
+			{
+				splitStack.push_back({ child, childEnd });
+				runStart = childEnd;
+			}
+		}
+		if (runStart < r.end)
+			work.push_back({ runStart, r.end });
+	}
+}
+
+void Scene::computeWorlds(uint32_t begin, uint32_t end)
+{
+	//front to back, so a parent is always done before its children read it
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t parent = parents[i];
+		if (parent == NO_NODE)
+			worlds[i] = locals[i];
+		else
+			multiply(worlds[parent], locals[i], worlds[i]);
+	}
+}
+
+uint32_t Scene::update(JobSystem* jobs)
+{
+	if (orderChanged)
+		sortNodes();
+
+	dirtyIndices.clear();
+	for (NodeHandle node : dirtyNodes)
+	{
+		handleDirty[node] = 0;
+		if (handleIndex[node] != NO_NODE)
+			dirtyIndices.push_back(handleIndex[node]);
+	}
+	dirtyNodes.clear();
+	if (dirtyIndices.empty())
+		return 0;
+	std::sort(dirtyIndices.begin(), dirtyIndices.end());
+
+	//a dirty node inside an earlier dirty subtree is covered by it
+	bool parallel = jobs && jobs->getThreadCount() > 1;
+	uint32_t updated = 0;
+	uint32_t coveredEnd = 0;
+	work.clear();
+	for (uint32_t index : dirtyIndices)
+	{
+		if (index < coveredEnd)
+			continue;
+		Range range = { index, index + subtreeSizes[index] };
+		coveredEnd = range.end;
+		updated += range.end - range.begin;
+		if (parallel)
+			splitRange(range);
+		else
+			work.push_back(range);
+	}
+
+	if (parallel && work.size() > 1)
+	{
+		jobs->parallelFor((uint32_t)work.size(), 1, [this](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				computeWorlds(work[i].begin, work[i].end);
+		});
+	}
+	else
+	{
+		for (const Range& range : work)
+			computeWorlds(range.begin, range.end);
+	}
+	return updated;
+}
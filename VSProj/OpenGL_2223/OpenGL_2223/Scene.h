@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+typedef uint32_t NodeHandle;
+
+//column-major 4x4, aligned for sse loads
+struct alignas(16) Transform
+{
+	float m[16];
+};
+
+//transform hierarchy in flat arrays, one array per field. nodes are kept in depth first
+//order, so every parent comes before its children and a subtree is the contiguous range
+//[index, index + subtree size). an update only walks the subtrees under nodes that changed,
+//front to back, and subtrees that don't overlap are handed to the job system.
+//handles stay valid while nodes move around in the arrays
+class Scene
+{
+public:
+	void reserve(size_t count);
+
+	//local is column-major, null for identity
+	NodeHandle create(NodeHandle parent = NO_NODE, const float* local = nullptr);
+	//takes the whole subtree with it at the next update
+	void destroy(NodeHandle node);
+	//false (and nothing changes) if parent is the node itself or one of its descendants
+	bool setParent(NodeHandle node, NodeHandle parent);
+	void setLocal(NodeHandle node, const float* local);
+
+	NodeHandle getParent(NodeHandle node) const;
+	const float* getLocal(NodeHandle node) const { return locals[handleIndex[node]].m; }
+	//as of the last update
+	const float* getWorld(NodeHandle node) const { return worlds[handleIndex[node]].m; }
+
+	//puts new and reparented nodes in order, then recomputes the world transform of every
+	//dirty node and its descendants. returns how many nodes it recomputed
+	uint32_t update(JobSystem* jobs = nullptr);
+
+	//the arrays themselves in hierarchy order, valid until the next create/destroy/setParent
+	size_t getNodeCount() const { return worlds.size(); }
+	const Transform* getWorlds() const { return worlds.data(); }
+	uint32_t getIndex(NodeHandle node) const { return handleIndex[node]; }
+
+	size_t size() const { return liveCount; }
+
+	static constexpr NodeHandle NO_NODE = 0xFFFFFFFF;
+	//subtrees bigger than this are split into smaller ranges for the job system
+	static constexpr uint32_t SPLIT_SIZE = 4096;
+
+private:
+	struct Range
+	{
+		uint32_t begin, end;
+	};
+
+	void markDirty(NodeHandle node);
+	void sortNodes();
+	void splitRange(Range range);
+	void computeWorlds(uint32_t begin, uint32_t end);
+
+	//per node, in hierarchy order
+	std::vector<uint32_t> parents;		//index, NO_NODE for roots
+	std::vector<uint32_t> subtreeSizes;	//the node itself plus all of its descendants
+	std::vector<Transform> locals;
+	std::vector<Transform> worlds;
+	std::vector<NodeHandle> nodeHandles;	//NO_NODE once destroyed
+
+	//per handle
+	std::vector<uint32_t> handleIndex;
+	std::vector<uint8_t> handleDirty;
+	std::vector<NodeHandle> freeHandles;
+
+	std::vector<NodeHandle> dirtyNodes;
+	bool orderChanged = false;
+	size_t liveCount = 0;
+
+	//scratch, kept so steady state doesn't allocate
+	std::vector<uint32_t> childStart, children, order, remap;
+	std::vector<uint32_t> dirtyIndices;
+	std::vector<Range> splitStack, work;
+	std::vector<uint32_t> scratchIndices;
+	std::vector<Transform> scratchTransforms;
+};
@@ -0,0 +1,177 @@
+#include "ShaderHotReload.h"
+#include "AssetIO.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static int64_t lastWriteTime(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? 0 : (int64_t)time.time_since_epoch().count();
+}
+
+static int64_t steadyMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ShaderHotReload::init(ProgramBuilder* programBuilder)
+{
+	shutdown();
+#ifdef __linux__
+	notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notify < 0)
+		std::cout << "ERROR STARTING INOTIFY, CHECKING SHADER TIMESTAMPS INSTEAD" << std::endl;
+#endif
+	builder = programBuilder;
+	return true;
+}
+
+void ShaderHotReload::shutdown()
+{
+#ifdef __linux__
+	if (notify >= 0)
+		close(notify);
+#endif
+	notify = -1;
+	watches.clear();
+	watchPrefixes.clear();
+	sources.clear();
+	files.clear();
+	builder = nullptr;
+}
+
+void ShaderHotReload::add(ProgramHandle handle, const char* vertexPath, const char* fragmentPath)
+{
+	if (!builder)
+		return;
+	Source source;
+	source.handle = handle;
+	source.vertexFile = watchFile(vertexPath);
+	source.fragmentFile = watchFile(fragmentPath);
+	sources.push_back(source);
+}
+
+uint32_t ShaderHotReload::watchFile(const char* path)
+{
+	for (uint32_t i = 0; i < (uint32_t)files.size(); i++)
+		if (files[i].path == path)
+			return i;
+	files.push_back({ path, lastWriteTime(path), false });
+
+#ifdef __linux__
+	if (notify >= 0)
+	{
+		//events name the file inside the directory, so keep the prefix to rebuild the path
+		std::string prefix = files.back().path;
+		size_t slash = prefix.find_last_of("/\\");
+		prefix.resize(slash == std::string::npos ? 0 : slash + 1);
+		bool watched = false;
+		for (const std::string& watchPrefix : watchPrefixes)
+			watched |= watchPrefix == prefix;
+		if (!watched)
+		{
+			//editors either write the file in place or write a new one and rename it over
+			int watch = inotify_add_watch(notify, prefix.empty() ? "." : prefix.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (watch < 0)
+				std::cout << "ERROR WATCHING SHADER DIRECTORY " << (prefix.empty() ? "." : prefix) << std::endl;
+			else
+			{
+				watches.push_back(watch);
+				watchPrefixes.push_back(prefix);
+			}
+		}
+	}
+#endif
+	return (uint32_t)files.size() - 1;
+}
+
+void ShaderHotReload::markChanged(std::string_view path)
+{
+	for (WatchedFile& file : files)
+		if (file.path == path)
+			file.changed = true;
+}
+
+void ShaderHotReload::readChanges()
+{
+#ifdef __linux__
+	if (notify >= 0)
+	{
+		//non-blocking, read until the queue is empty
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+		{
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = (const inotify_event*)(buffer + offset);
+				if (event->len > 0)
+				{
+					for (size_t i = 0; i < watches.size(); i++)
+						if (watches[i] == event->wd)
+							markChanged(watchPrefixes[i] + event->name);
+				}
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+		return;
+	}
+#endif
+
+	int64_t now = steadyMs();
+	if (now < nextCheck)
+		return;
+	nextCheck = now + CHECK_INTERVAL_MS;
+	for (WatchedFile& file : files)
+	{
+		int64_t modified = lastWriteTime(file.path);
+		if (modified != file.modified)
+		{
+			file.modified = modified;
+			file.changed = true;
+		}
+	}
+}
+
+void ShaderHotReload::poll()
+{
+	if (!builder)
+		return;
+
+	readChanges();
+	bool changed = false;
+	for (const WatchedFile& file : files)
+		changed |= file.changed;
+	if (!changed)
+		return;
+
+	for (const Source& source : sources)
+	{
+		const WatchedFile& vertex = files[source.vertexFile];
+		const WatchedFile& fragment = files[source.fragmentFile];
+		if (!vertex.changed && !fragment.changed)
+			continue;
+
+		//straight from disk, the manifest's mappings are from startup
+		MappedFile vertexFile, fragmentFile;
+		if (!vertexFile.open(vertex.path.c_str()) || !fragmentFile.open(fragment.path.c_str()))
+		{
+			std::cout << "ERROR OPENING " << vertex.path << " OR " << fragment.path << " FOR RELOAD" << std::endl;
+			continue;
+		}
+		std::cout << "reloading " << vertex.path << " + " << fragment.path << std::endl;
+		builder->reload(source.handle, vertexFile.view(), fragmentFile.view());
+		reloadCount++;
+	}
+
+	for (WatchedFile& file : files)
+		file.changed = false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AsyncProgram.h"
+
+//rebuilds programs when their shader files change on disk. linux gets change events from
+//inotify on the shader directories, elsewhere the files' timestamps are checked every
+//CHECK_INTERVAL_MS. only programs that use a changed file are resubmitted, and the builder
+//swaps each one in at its poll() once it links (or keeps the old one if it doesn't).
+//nothing is watched and poll() returns straight away until init()
+class ShaderHotReload
+{
+public:
+	ShaderHotReload() = default;
+	ShaderHotReload(const ShaderHotReload&) = delete;
+	ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+	~ShaderHotReload() { shutdown(); }
+
+	bool init(ProgramBuilder* builder);
+	void shutdown();
+	bool isEnabled() const { return builder != nullptr; }
+
+	//rebuild the program from these files whenever either of them changes
+	void add(ProgramHandle handle, const char* vertexPath, const char* fragmentPath);
+	//call once per frame, before ProgramBuilder::poll()
+	void poll();
+
+	unsigned getReloadCount() const { return reloadCount; }
+
+	static const int CHECK_INTERVAL_MS = 250;
+
+private:
+	struct Source
+	{
+		ProgramHandle handle;
+		uint32_t vertexFile, fragmentFile;
+	};
+
+	struct WatchedFile
+	{
+		std::string path;
+		int64_t modified;	//last write time, only used without inotify
+		bool changed;
+	};
+
+	uint32_t watchFile(const char* path);
+	//flags the files that changed since the last call
+	void readChanges();
+	void markChanged(std::string_view path);
+
+	ProgramBuilder* builder = nullptr;
+	std::vector<Source> sources;
+	std::vector<WatchedFile> files;
+	unsigned reloadCount = 0;
+
+	//inotify descriptor and one watch per directory, with the prefix its files' paths start with
+	int notify = -1;
+	std::vector<int> watches;
+	std::vector<std::string> watchPrefixes;
+	int64_t nextCheck = 0;
+};
@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(0.5f, 0.5f, 0.5f, 1.0f);
+}
\ No newline at end of file
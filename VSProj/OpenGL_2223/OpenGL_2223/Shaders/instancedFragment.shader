@@ -0,0 +1,8 @@
+#version 330 core
+in vec4 colour;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = colour;
+}
\ No newline at end of file
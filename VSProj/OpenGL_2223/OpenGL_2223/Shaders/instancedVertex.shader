@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in mat4 aTransform;
+layout(location = 5) in vec4 aColour;
+
+layout(std140) uniform Frame
+{
+	mat4 viewProjection;
+	vec4 time;
+};
+
+out vec4 colour;
+
+void main()
+{
+	gl_Position = viewProjection * aTransform * vec4(aPos, 1.0);
+	colour = aColour;
+}
\ No newline at end of file
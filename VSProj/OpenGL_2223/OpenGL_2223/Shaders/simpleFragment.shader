@@ -1,7 +1,8 @@
 #version 330 core
+in vec4 colour;
 out vec4 FragColor;
 
 void main()
 {
-    FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);
-} 
\ No newline at end of file
+    FragColor = colour;
+}
\ No newline at end of file
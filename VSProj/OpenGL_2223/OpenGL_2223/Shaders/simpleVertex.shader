@@ -1,7 +1,23 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
 
+//UniformBuffer.h FrameUniforms/ObjectUniforms
+layout(std140) uniform Frame
+{
+	mat4 viewProjection;
+	vec4 time;
+};
+
+layout(std140) uniform Object
+{
+	mat4 model;
+	vec4 objectColour;
+};
+
+out vec4 colour;
+
 void main()
 {
-	gl_Position = vec4(aPos, 1.0);
+	gl_Position = viewProjection * model * vec4(aPos, 1.0);
+	colour = objectColour;
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+in vec4 colour;
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D albedo;
+
+void main()
+{
+    FragColor = texture(albedo, uv) * colour;
+}
\ No newline at end of file
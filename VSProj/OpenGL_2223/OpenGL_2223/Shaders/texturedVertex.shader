@@ -0,0 +1,25 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+layout(std140) uniform Frame
+{
+	mat4 viewProjection;
+	vec4 time;
+};
+
+layout(std140) uniform Object
+{
+	mat4 model;
+	vec4 objectColour;
+};
+
+out vec4 colour;
+out vec2 uv;
+
+void main()
+{
+	gl_Position = viewProjection * model * vec4(aPos, 1.0);
+	colour = objectColour;
+	//no uv attribute yet, project the texture along z
+	uv = aPos.xy + 0.5;
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+
+void StreamBuffer::init(GLenum bufferTarget, GLsizeiptr size)
+{
+	target = bufferTarget;
+	segmentSize = size;
+	persistent = glExt.bufferStorage;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glExt.bufferStorageAlloc(target, segmentSize * SEGMENTS, nullptr, flags);
+		mapped = (char*)glMapBufferRange(target, 0, segmentSize * SEGMENTS, flags);
+		if (mapped == nullptr)
+		{
+			//fall back to orphaning, storage is immutable so start over with a new buffer
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+			persistent = false;
+		}
+	}
+
+	if (!persistent)
+		glBufferData(target, segmentSize, nullptr, GL_STREAM_DRAW);
+
+	segment = 0;
+	head = 0;
+}
+
+void StreamBuffer::destroy()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (buffer)
+	{
+		if (mapped)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	mapped = nullptr;
+}
+
+void StreamBuffer::beginFrame()
+{
+	head = 0;
+
+	if (persistent)
+	{
+		segment = (segment + 1) % SEGMENTS;
+
+		//wait until the gpu is done with what we wrote here SEGMENTS frames ago
+		GLsync& fence = fences[segment];
+		if (fence)
+		{
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				stats.fenceWaits++;
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		return;
+	}
+
+	//orphan the old storage, the driver hands back fresh memory without a sync
+	glBindBuffer(target, buffer);
+	glBufferData(target, segmentSize, nullptr, GL_STREAM_DRAW);
+	mapped = (char*)glMapBufferRange(target, 0, segmentSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	StreamAllocation allocation;
+
+	GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+	if (mapped == nullptr || start + size > segmentSize)
+	{
+		stats.overflows++;
+		return allocation;
+	}
+	head = start + size;
+
+	GLintptr base = persistent ? (GLintptr)segment * segmentSize : 0;
+	allocation.data = mapped + base + start;
+	allocation.buffer = buffer;
+	allocation.offset = base + start;
+	allocation.size = size;
+
+	stats.allocations++;
+	return allocation;
+}
+
+void StreamBuffer::flush()
+{
+	//the persistent mapping is coherent, nothing to do
+	if (persistent || mapped == nullptr)
+		return;
+
+	glBindBuffer(target, buffer);
+	glUnmapBuffer(target);
+	mapped = nullptr;
+}
+
+void StreamBuffer::endFrame()
+{
+	if (persistent)
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
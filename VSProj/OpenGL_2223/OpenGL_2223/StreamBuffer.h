@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+//a piece of the stream buffer for this frame, write to data and draw from buffer+offset
+struct StreamAllocation
+{
+	void* data = nullptr;
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+struct StreamBufferStats
+{
+	unsigned allocations = 0;
+	unsigned overflows = 0;		//allocations that didn't fit in the segment
+	unsigned fenceWaits = 0;	//frames where the gpu still used the segment
+};
+
+//per-frame dynamic vertex/index data. with ARB_buffer_storage the buffer is three
+//persistently mapped segments guarded by a fence each, otherwise the buffer is
+//orphaned every frame and mapped with glMapBufferRange
+//
+//per frame: beginFrame, allocate..., flush, draw, endFrame
+class StreamBuffer
+{
+public:
+	//needs a current context, segmentSize is the most that can be streamed per frame
+	void init(GLenum target, GLsizeiptr segmentSize);
+	//frees the gl objects, call before the context goes away
+	void destroy();
+
+	void beginFrame();
+	StreamAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	//make the writes visible before drawing, unmaps in the orphaning path
+	void flush();
+	//fence the segment once the frame's draws have been submitted
+	void endFrame();
+
+	bool isPersistent() const { return persistent; }
+	GLuint getBuffer() const { return buffer; }
+
+	const StreamBufferStats& getStats() const { return stats; }
+
+	static const int SEGMENTS = 3;
+
+private:
+	GLenum target = GL_ARRAY_BUFFER;
+	GLuint buffer = 0;
+	GLsizeiptr segmentSize = 0;
+	bool persistent = false;
+
+	char* mapped = nullptr;	//whole buffer when persistent, current segment otherwise
+	int segment = 0;
+	GLsizeiptr head = 0;
+	GLsync fences[SEGMENTS] = {};
+
+	StreamBufferStats stats;
+};
@@ -0,0 +1,376 @@
+#include "TextureStreamer.h"
+#include "AssetIO.h"
+
+#include <cstring>
+#include <iostream>
+
+//widest row that can always go up in one frame whatever the budget (16k rgba8)
+static const size_t MAX_ROW_BYTES = 16384 * 4;
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+//next whitespace separated number in a ppm header, skipping # comments
+static bool readPPMNumber(const char*& at, const char* end, int& value)
+{
+	while (at < end && (isSpace(*at) || *at == '#'))
+	{
+		if (*at == '#')
+			while (at < end && *at != '\n') at++;
+		else
+			at++;
+	}
+	if (at == end || *at < '0' || *at > '9')
+		return false;
+
+	value = 0;
+	while (at < end && *at >= '0' && *at <= '9')
+		value = value * 10 + (*at++ - '0');
+	return true;
+}
+
+static bool decodePPM(const MappedFile& file, DecodedImage& image)
+{
+	const char* at = file.data() + 2;
+	const char* end = file.data() + file.size();
+
+	int maxValue;
+	if (!readPPMNumber(at, end, image.width) || !readPPMNumber(at, end, image.height) || !readPPMNumber(at, end, maxValue))
+		return false;
+	//exactly one whitespace character between the header and the pixels
+	at++;
+	if (maxValue != 255 || image.width <= 0 || image.height <= 0 || end - at < (ptrdiff_t)image.width * image.height * 3)
+		return false;
+
+	//ppm rows go top down, gl wants bottom up
+	image.pixels.resize((size_t)image.width * image.height * 4);
+	for (int y = 0; y < image.height; y++)
+	{
+		const unsigned char* src = (const unsigned char*)at + (size_t)(image.height - 1 - y) * image.width * 3;
+		unsigned char* dst = &image.pixels[(size_t)y * image.width * 4];
+		for (int x = 0; x < image.width; x++)
+		{
+			dst[x * 4 + 0] = src[x * 3 + 0];
+			dst[x * 4 + 1] = src[x * 3 + 1];
+			dst[x * 4 + 2] = src[x * 3 + 2];
+			dst[x * 4 + 3] = 255;
+		}
+	}
+	return true;
+}
+
+static bool decodeTGA(const MappedFile& file, DecodedImage& image)
+{
+	const unsigned char* header = (const unsigned char*)file.data();
+	if (file.size() < 18)
+		return false;
+
+	//uncompressed true colour only
+	int idLength = header[0];
+	int colourMapType = header[1];
+	int imageType = header[2];
+	image.width = header[12] | header[13] << 8;
+	image.height = header[14] | header[15] << 8;
+	int bytesPerPixel = header[16] / 8;
+	bool topDown = (header[17] & 0x20) != 0;
+	if (colourMapType != 0 || imageType != 2 || (bytesPerPixel != 3 && bytesPerPixel != 4) || image.width == 0 || image.height == 0)
+		return false;
+
+	const unsigned char* pixels = header + 18 + idLength;
+	if (file.size() < 18 + idLength + (size_t)image.width * image.height * bytesPerPixel)
+		return false;
+
+	//bgr(a), bottom up unless the descriptor says otherwise
+	image.pixels.resize((size_t)image.width * image.height * 4);
+	for (int y = 0; y < image.height; y++)
+	{
+		int srcRow = topDown ? image.height - 1 - y : y;
+		const unsigned char* src = pixels + (size_t)srcRow * image.width * bytesPerPixel;
+		unsigned char* dst = &image.pixels[(size_t)y * image.width * 4];
+		for (int x = 0; x < image.width; x++, src += bytesPerPixel)
+		{
+			dst[x * 4 + 0] = src[2];
+			dst[x * 4 + 1] = src[1];
+			dst[x * 4 + 2] = src[0];
+			dst[x * 4 + 3] = bytesPerPixel == 4 ? src[3] : 255;
+		}
+	}
+	return true;
+}
+
+bool decodeImage(const char* path, DecodedImage& image)
+{
+	MappedFile file;
+	if (!file.open(path) || file.size() < 2)
+		return false;
+
+	if (file.data()[0] == 'P' && file.data()[1] == '6')
+		return decodePPM(file, image);
+	return decodeTGA(file, image);
+}
+
+void buildMipChain(DecodedImage& image)
+{
+	int levels = 1;
+	while ((image.width >> levels) > 0 || (image.height >> levels) > 0) levels++;
+
+	image.levelOffsets.resize(levels);
+	size_t total = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		image.levelOffsets[level] = total;
+		total += image.levelBytes(level);
+	}
+	image.pixels.resize(total);
+
+	//2x2 box filter, odd edges reuse the last row/column
+	for (int level = 1; level < levels; level++)
+	{
+		int srcWidth = image.levelWidth(level - 1), srcHeight = image.levelHeight(level - 1);
+		int width = image.levelWidth(level), height = image.levelHeight(level);
+		const unsigned char* src = &image.pixels[image.levelOffsets[level - 1]];
+		unsigned char* dst = &image.pixels[image.levelOffsets[level]];
+
+		for (int y = 0; y < height; y++)
+		{
+			int y0 = y * 2, y1 = y * 2 + 1 < srcHeight ? y * 2 + 1 : y0;
+			for (int x = 0; x < width; x++)
+			{
+				int x0 = x * 2, x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : x0;
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = src[((size_t)y0 * srcWidth + x0) * 4 + c] + src[((size_t)y0 * srcWidth + x1) * 4 + c]
+						+ src[((size_t)y1 * srcWidth + x0) * 4 + c] + src[((size_t)y1 * srcWidth + x1) * 4 + c];
+					dst[((size_t)y * width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+void TextureStreamer::init(size_t budgetBytes, int workerCount)
+{
+	budget = budgetBytes;
+	//room for one full row past the budget so a huge level still moves every frame
+	stream.init(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)(budget + MAX_ROW_BYTES));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	stopping = false;
+	if (workerCount < 1) workerCount = 1;
+	for (int i = 0; i < workerCount; i++)
+		workers.emplace_back(&TextureStreamer::workerLoop, this);
+}
+
+void TextureStreamer::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+	jobs.clear();
+
+	for (std::unique_ptr<StreamedTexture>& texture : textures)
+	{
+		if (texture->fence) glDeleteSync(texture->fence);
+		if (texture->texture) glDeleteTextures(1, &texture->texture);
+	}
+	textures.clear();
+	stream.destroy();
+}
+
+TextureHandle TextureStreamer::request(const char* path)
+{
+	TextureHandle handle = (TextureHandle)textures.size();
+	textures.emplace_back(new StreamedTexture());
+	textures.back()->path = path;
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(textures.back().get());
+	}
+	jobReady.notify_one();
+	return handle;
+}
+
+void TextureStreamer::workerLoop()
+{
+	for (;;)
+	{
+		StreamedTexture* texture;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+			texture = jobs.front();
+			jobs.pop_front();
+		}
+
+		texture->state = TextureState::Decoding;
+		if (!decodeImage(texture->path.c_str(), texture->image))
+		{
+			std::cout << "ERROR DECODING TEXTURE " << texture->path << std::endl;
+			texture->state = TextureState::Failed;
+			continue;
+		}
+		buildMipChain(texture->image);
+
+		//publishes the image to the render thread
+		texture->state = TextureState::Decoded;
+	}
+}
+
+void TextureStreamer::allocateLevels(StreamedTexture& texture)
+{
+	const DecodedImage& image = texture.image;
+	texture.levelCount = image.levelCount();
+
+	//storage only, a bound unpack buffer would turn the null pointer into an offset
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glGenTextures(1, &texture.texture);
+	glBindTexture(GL_TEXTURE_2D, texture.texture);
+	for (int level = 0; level < texture.levelCount; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, image.levelWidth(level), image.levelHeight(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levelCount - 1);
+
+	texture.nextLevel = texture.levelCount - 1;
+	texture.nextRow = 0;
+	texture.residentLevel = texture.levelCount;
+	texture.state = TextureState::Uploading;
+}
+
+bool TextureStreamer::planBand(StreamedTexture& texture, size_t& budgetLeft)
+{
+	const DecodedImage& image = texture.image;
+	int level = texture.nextLevel;
+	size_t rowBytes = (size_t)image.levelWidth(level) * 4;
+	int rowsLeft = image.levelHeight(level) - texture.nextRow;
+
+	int rows = (int)(budgetLeft / rowBytes);
+	if (rows > rowsLeft) rows = rowsLeft;
+	//always let one row through per frame or a level wider than the budget would never finish
+	if (rows == 0 && (!uploads.empty() || rowBytes > MAX_ROW_BYTES))
+		return false;
+	if (rows == 0) rows = 1;
+
+	size_t bytes = rows * rowBytes;
+	StreamAllocation space = stream.allocate((GLsizeiptr)bytes, 4);
+	if (space.data == nullptr)
+		return false;
+	std::memcpy(space.data, &image.pixels[image.levelOffsets[level] + texture.nextRow * rowBytes], bytes);
+
+	PendingUpload upload = { &texture, level, texture.nextRow, rows, space.offset, rows == rowsLeft };
+	uploads.push_back(upload);
+
+	budgetLeft = bytes < budgetLeft ? budgetLeft - bytes : 0;
+	texture.nextRow += rows;
+	if (upload.lastBand)
+	{
+		texture.nextLevel--;
+		texture.nextRow = 0;
+	}
+	return true;
+}
+
+void TextureStreamer::update()
+{
+	stats.bytesThisFrame = 0;
+	stats.uploadsThisFrame = 0;
+
+	bool work = false;
+	for (std::unique_ptr<StreamedTexture>& texture : textures)
+	{
+		TextureState state = texture->state.load();
+		if (state == TextureState::Decoded)
+		{
+			allocateLevels(*texture);
+			state = TextureState::Uploading;
+		}
+
+		//the last level went up in an earlier frame, resident once the gpu has copied it
+		if (state == TextureState::Uploading && texture->fence)
+		{
+			if (glClientWaitSync(texture->fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+			{
+				glDeleteSync(texture->fence);
+				texture->fence = nullptr;
+				texture->image = DecodedImage();
+				texture->state = TextureState::Resident;
+				stats.resident++;
+			}
+		}
+
+		if (state == TextureState::Uploading && texture->nextLevel >= 0)
+			work = true;
+	}
+	if (!work)
+		return;
+
+	//copy as much as the budget allows, coarsest level of any texture first
+	stream.beginFrame();
+	uploads.clear();
+	size_t budgetLeft = budget;
+	for (;;)
+	{
+		StreamedTexture* best = nullptr;
+		size_t bestBytes = 0;
+		for (std::unique_ptr<StreamedTexture>& texture : textures)
+		{
+			if (texture->state.load() != TextureState::Uploading || texture->nextLevel < 0)
+				continue;
+			size_t bytes = texture->image.levelBytes(texture->nextLevel);
+			if (best == nullptr || bytes < bestBytes)
+			{
+				best = texture.get();
+				bestBytes = bytes;
+			}
+		}
+		if (best == nullptr || !planBand(*best, budgetLeft))
+			break;
+	}
+	stream.flush();
+
+	//the gpu pulls the pixels out of the buffer on its own time
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.getBuffer());
+	for (const PendingUpload& upload : uploads)
+	{
+		StreamedTexture& texture = *upload.texture;
+		int width = texture.image.levelWidth(upload.level);
+
+		glBindTexture(GL_TEXTURE_2D, texture.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.row, width, upload.rows, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)upload.offset);
+		stats.bytesThisFrame += (size_t)width * upload.rows * 4;
+		stats.uploadsThisFrame++;
+
+		if (upload.lastBand)
+		{
+			//let sampling reach down to the level that just arrived
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+			texture.residentLevel = upload.level;
+			if (upload.level == 0)
+				texture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	stream.endFrame();
+
+	stats.bytesTotal += stats.bytesThisFrame;
+}
+
+GLuint TextureStreamer::get(TextureHandle handle, GLuint fallback) const
+{
+	const StreamedTexture& texture = *textures[handle];
+	return texture.texture && texture.residentLevel < texture.levelCount ? texture.texture : fallback;
+}
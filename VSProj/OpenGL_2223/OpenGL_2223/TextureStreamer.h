@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "StreamBuffer.h"
+
+//rgba8 image with its whole mip chain, level 0 first
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+	std::vector<size_t> levelOffsets;
+
+	int levelCount() const { return (int)levelOffsets.size(); }
+	int levelWidth(int level) const { return width >> level > 0 ? width >> level : 1; }
+	int levelHeight(int level) const { return height >> level > 0 ? height >> level : 1; }
+	size_t levelBytes(int level) const { return (size_t)levelWidth(level) * levelHeight(level) * 4; }
+};
+
+//binary ppm (P6) and uncompressed 24/32 bit tga to rgba8, false on anything else
+bool decodeImage(const char* path, DecodedImage& image);
+//box filters level 0 down to 1x1
+void buildMipChain(DecodedImage& image);
+
+enum class TextureState
+{
+	Queued,		//waiting for a worker
+	Decoding,
+	Decoded,	//mips ready in memory, waiting for upload budget
+	Uploading,	//some levels on the gpu, coarsest first
+	Resident,	//every level uploaded and the fence passed
+	Failed
+};
+
+typedef unsigned TextureHandle;
+
+struct TextureStreamerStats
+{
+	size_t bytesThisFrame = 0;
+	size_t bytesTotal = 0;
+	unsigned uploadsThisFrame = 0;	//glTexSubImage2D calls
+	unsigned resident = 0;
+};
+
+//loads textures without blocking the render thread. workers read and decode files and
+//build the mips, update() then copies at most budget bytes a frame into a pixel unpack
+//stream buffer and issues glTexSubImage2D from it, so the copy to the gpu is async too.
+//levels go up coarsest first (across every texture) and GL_TEXTURE_BASE_LEVEL follows
+//them, so a texture is usable, if blurry, as soon as its 1x1 level lands
+class TextureStreamer
+{
+public:
+	//needs a current context, budget is upload bytes per frame
+	void init(size_t budgetBytes, int workerCount = 2);
+	void shutdown();
+
+	TextureHandle request(const char* path);
+
+	//render thread, once a frame
+	void update();
+
+	TextureState getState(TextureHandle handle) const { return textures[handle]->state.load(); }
+	//the texture once its first level is up, fallback before that (or if it failed)
+	GLuint get(TextureHandle handle, GLuint fallback) const;
+	//finest level that can be sampled, levelCount while nothing is up
+	int getResidentLevel(TextureHandle handle) const { return textures[handle]->residentLevel; }
+
+	const TextureStreamerStats& getStats() const { return stats; }
+
+private:
+	struct StreamedTexture
+	{
+		std::string path;
+		std::atomic<TextureState> state{ TextureState::Queued };
+		DecodedImage image;		//owned by the worker until state is Decoded
+
+		GLuint texture = 0;
+		int levelCount = 0;
+		int nextLevel = -1;		//level being uploaded, counts down to 0
+		int nextRow = 0;		//levels bigger than the budget go up in bands of rows
+		int residentLevel = 0;
+		GLsync fence = nullptr;
+	};
+
+	//a band copied into the stream buffer, issued after the buffer is flushed
+	struct PendingUpload
+	{
+		StreamedTexture* texture;
+		int level;
+		int row;
+		int rows;
+		GLintptr offset;
+		bool lastBand;	//level complete once this is up
+	};
+
+	void workerLoop();
+	void allocateLevels(StreamedTexture& texture);
+	//copies the next band of the texture's current level, false when the budget ran out
+	bool planBand(StreamedTexture& texture, size_t& budgetLeft);
+
+	std::vector<std::unique_ptr<StreamedTexture>> textures;
+	StreamBuffer stream;
+	size_t budget = 0;
+	std::vector<PendingUpload> uploads;
+	TextureStreamerStats stats;
+
+	std::vector<std::thread> workers;
+	std::deque<StreamedTexture*> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	bool stopping = false;
+};
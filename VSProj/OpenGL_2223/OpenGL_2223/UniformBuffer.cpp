@@ -0,0 +1,49 @@
+#include "UniformBuffer.h"
+
+#include <cstring>
+
+void bindUniformBlocks(GLuint program)
+{
+	GLuint frame = glGetUniformBlockIndex(program, "Frame");
+	if (frame != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame, FRAME_UNIFORM_BINDING);
+
+	GLuint object = glGetUniformBlockIndex(program, "Object");
+	if (object != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, object, OBJECT_UNIFORM_BINDING);
+}
+
+void UniformRing::init(int maxBlocks, GLsizeiptr maxBlockSize)
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment <= 0) alignment = 256;
+
+	//every block starts on the alignment, which also keeps the segment starts aligned
+	GLsizeiptr blockSize = (maxBlockSize + alignment - 1) / alignment * alignment;
+	stream.init(GL_UNIFORM_BUFFER, blockSize * maxBlocks);
+}
+
+void UniformRing::destroy()
+{
+	stream.destroy();
+}
+
+UniformAllocation UniformRing::allocate(const void* data, GLsizeiptr size)
+{
+	UniformAllocation allocation;
+
+	StreamAllocation space = stream.allocate(size, alignment);
+	if (space.data == nullptr)
+		return allocation;
+
+	std::memcpy(space.data, data, size);
+	allocation.buffer = space.buffer;
+	allocation.offset = space.offset;
+	allocation.size = space.size;
+	return allocation;
+}
+
+void UniformRing::bind(GLuint binding, const UniformAllocation& allocation)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size);
+}
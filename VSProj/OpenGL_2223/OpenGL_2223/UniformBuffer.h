@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "StreamBuffer.h"
+
+//std140 building blocks. alignas gives each type its std140 base alignment so a
+//struct made of them lines up with the glsl block, the static_asserts below catch the rest.
+//vec3 is padded to 16 bytes, don't put a float after one expecting it to pack in
+namespace std140
+{
+	struct alignas(16) vec4 { float x, y, z, w; };
+	struct alignas(16) vec3 { float x, y, z, pad; };
+	struct alignas(8) vec2 { float x, y; };
+	struct alignas(16) mat4 { float m[16]; };	//column-major
+}
+
+//binding points, glsl 330 has no layout(binding) so bindUniformBlocks sets them by name
+const GLuint FRAME_UNIFORM_BINDING = 0;
+const GLuint OBJECT_UNIFORM_BINDING = 1;
+
+//uniform Frame in the shaders
+struct FrameUniforms
+{
+	std140::mat4 viewProjection;
+	std140::vec4 time;	//x seconds, y frame delta
+};
+static_assert(offsetof(FrameUniforms, viewProjection) == 0, "Frame block layout");
+static_assert(offsetof(FrameUniforms, time) == 64, "Frame block layout");
+static_assert(sizeof(FrameUniforms) == 80, "Frame block layout");
+
+//uniform Object in the shaders
+struct ObjectUniforms
+{
+	std140::mat4 model;
+	std140::vec4 colour;
+};
+static_assert(offsetof(ObjectUniforms, model) == 0, "Object block layout");
+static_assert(offsetof(ObjectUniforms, colour) == 64, "Object block layout");
+static_assert(sizeof(ObjectUniforms) == 80, "Object block layout");
+
+//points the program's Frame/Object blocks (if it has them) at the binding points above,
+//needed after every link or binary load
+void bindUniformBlocks(GLuint program);
+
+//a block's worth of data in the ring, bind with UniformRing::bind or put it in a DrawPacket
+struct UniformAllocation
+{
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+//per-frame uniform data for every draw in one buffer. blocks are sub-allocated at
+//GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and bound per draw with glBindBufferRange, so a
+//frame costs one upload instead of a glUniform call per value per draw.
+//sits on a StreamBuffer, same beginFrame/flush/endFrame rhythm
+class UniformRing
+{
+public:
+	//needs a current context, room for maxBlocks blocks of up to maxBlockSize bytes per frame
+	void init(int maxBlocks, GLsizeiptr maxBlockSize);
+	void destroy();
+
+	void beginFrame() { stream.beginFrame(); }
+	void flush() { stream.flush(); }
+	void endFrame() { stream.endFrame(); }
+
+	//size 0 if the frame's space ran out
+	UniformAllocation allocate(const void* data, GLsizeiptr size);
+	template<typename T> UniformAllocation push(const T& block) { return allocate(&block, sizeof(T)); }
+
+	static void bind(GLuint binding, const UniformAllocation& allocation);
+
+	GLint getAlignment() const { return alignment; }
+	const StreamBufferStats& getStats() const { return stream.getStats(); }
+
+private:
+	StreamBuffer stream;
+	GLint alignment = 256;
+};